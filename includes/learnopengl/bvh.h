@@ -0,0 +1,339 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <vector>
+
+// counts of the last BVH::cull()
+struct CullStats
+{
+    unsigned int nodesVisited;
+    unsigned int boxesTested;   // leaves that went through the SIMD test
+    unsigned int visible;
+    unsigned int culled;
+};
+
+// dynamic bounding volume hierarchy over scene objects, after the dynamic AABB tree of Box2D (Catto):
+// leaves store a box enlarged by a margin, so an object that moves a little does not touch the tree at all,
+// inserts pick the sibling that grows the tree's surface area least and AVL style rotations keep it balanced.
+// culling walks the tree with one box test per node. a node entirely inside the frustum accepts its subtree
+// without further tests, leaves below straddling nodes are collected and tested in packets by cullBoxes().
+class BVH
+{
+public:
+    static constexpr float MARGIN = 0.1f;
+
+    BVH() : root(-1), freeList(-1), leafCount(0) {}
+
+    // adds an object with the given world space box, returns the leaf used to update or remove it
+    int insert(const AABB &box, unsigned int object)
+    {
+        int leaf = allocate();
+        nodes[leaf].tight = box;
+        nodes[leaf].box = box.expanded(MARGIN);
+        nodes[leaf].object = object;
+        nodes[leaf].height = 0;
+        insertLeaf(leaf);
+        leafCount++;
+        return leaf;
+    }
+
+    void remove(int leaf)
+    {
+        removeLeaf(leaf);
+        release(leaf);
+        leafCount--;
+    }
+
+    // moves an object. the tree only changes when the new box leaves the enlarged one, returns true then
+    bool update(int leaf, const AABB &box)
+    {
+        nodes[leaf].tight = box;
+        if(nodes[leaf].box.contains(box))
+            return false;
+        removeLeaf(leaf);
+        nodes[leaf].box = box.expanded(MARGIN);
+        insertLeaf(leaf);
+        return true;
+    }
+
+    // appends the objects whose boxes intersect frustum to visible
+    CullStats cull(const Frustum &frustum, std::vector<unsigned int> &visible) const
+    {
+        CullStats stats = { 0, 0, 0, 0 };
+        size_t first = visible.size();
+        candidates.clear();
+        if(root >= 0)
+        {
+            stack.clear();
+            stack.push_back(root);
+            while(!stack.empty())
+            {
+                int index = stack.back();
+                stack.pop_back();
+                const Node &node = nodes[index];
+                stats.nodesVisited++;
+                if(node.leaf())
+                {
+                    candidates.push_back(index);
+                    continue;
+                }
+                FrustumTest test = frustum.test(node.box);
+                if(test == FRUSTUM_INSIDE)
+                    collect(index, visible);
+                else if(test == FRUSTUM_INTERSECTS)
+                {
+                    stack.push_back(node.left);
+                    stack.push_back(node.right);
+                }
+            }
+        }
+
+        // the leaves under straddling nodes, four boxes per plane test
+        boxes.resize(candidates.size());
+        results.resize(candidates.size());
+        for(size_t i = 0; i < candidates.size(); i++)
+            boxes[i] = nodes[candidates[i]].tight;
+        if(!boxes.empty())
+            cullBoxes(frustum, &boxes[0], boxes.size(), &results[0]);
+        for(size_t i = 0; i < candidates.size(); i++)
+            if(results[i])
+                visible.push_back(nodes[candidates[i]].object);
+
+        stats.boxesTested = candidates.size();
+        stats.visible = visible.size() - first;
+        stats.culled = leafCount - stats.visible;
+        return stats;
+    }
+
+    unsigned int size() const
+    {
+        return leafCount;
+    }
+
+    int height() const
+    {
+        return root >= 0 ? nodes[root].height : 0;
+    }
+
+private:
+    struct Node
+    {
+        AABB box;               // enlarged for leaves, the union of the children otherwise
+        AABB tight;             // the object's own box, leaves only
+        int parent;             // next free node while on the free list
+        int left, right;
+        unsigned int object;
+        int height;             // 0 for leaves, -1 while free
+
+        bool leaf() const
+        {
+            return left < 0;
+        }
+    };
+
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    unsigned int leafCount;
+    // scratch space of cull()
+    mutable std::vector<int> stack, candidates;
+    mutable std::vector<AABB> boxes;
+    mutable std::vector<unsigned char> results;
+
+    int allocate()
+    {
+        if(freeList < 0)
+        {
+            Node node;
+            node.height = -1;
+            node.parent = -1;
+            nodes.push_back(node);
+            freeList = nodes.size() - 1;
+        }
+        int index = freeList;
+        freeList = nodes[index].parent;
+        nodes[index].parent = nodes[index].left = nodes[index].right = -1;
+        nodes[index].object = 0;
+        nodes[index].height = 0;
+        return index;
+    }
+
+    void release(int index)
+    {
+        nodes[index].parent = freeList;
+        nodes[index].height = -1;
+        freeList = index;
+    }
+
+    // every object of the subtree, no tests needed
+    void collect(int index, std::vector<unsigned int> &visible) const
+    {
+        size_t base = stack.size();
+        stack.push_back(index);
+        while(stack.size() > base)
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if(node.leaf())
+                visible.push_back(node.object);
+            else
+            {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+            }
+        }
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if(root < 0)
+        {
+            root = leaf;
+            nodes[root].parent = -1;
+            return;
+        }
+
+        // descend to the sibling with the least cost: the area the new parent adds plus the growth of every ancestor
+        const AABB box = nodes[leaf].box;
+        int index = root;
+        while(!nodes[index].leaf())
+        {
+            const Node &node = nodes[index];
+            AABB combined = node.box;
+            combined.add(box);
+            float cost = 2.0f * combined.area();
+            float inheritance = 2.0f * (combined.area() - node.box.area());
+
+            float childCost[2];
+            int children[2] = { node.left, node.right };
+            for(int c = 0; c < 2; c++)
+            {
+                AABB grown = nodes[children[c]].box;
+                grown.add(box);
+                childCost[c] = grown.area() + inheritance;
+                if(!nodes[children[c]].leaf())
+                    childCost[c] -= nodes[children[c]].box.area();
+            }
+            if(cost < childCost[0] && cost < childCost[1])
+                break;
+            index = childCost[0] < childCost[1] ? children[0] : children[1];
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int parent = allocate();
+        nodes[parent].parent = oldParent;
+        nodes[parent].box = nodes[sibling].box;
+        nodes[parent].box.add(box);
+        nodes[parent].height = nodes[sibling].height + 1;
+        nodes[parent].left = sibling;
+        nodes[parent].right = leaf;
+        nodes[sibling].parent = parent;
+        nodes[leaf].parent = parent;
+        if(oldParent < 0)
+            root = parent;
+        else if(nodes[oldParent].left == sibling)
+            nodes[oldParent].left = parent;
+        else
+            nodes[oldParent].right = parent;
+
+        refit(nodes[leaf].parent);
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if(leaf == root)
+        {
+            root = -1;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+        release(parent);
+        if(grandParent < 0)
+        {
+            root = sibling;
+            nodes[sibling].parent = -1;
+            return;
+        }
+        if(nodes[grandParent].left == parent)
+            nodes[grandParent].left = sibling;
+        else
+            nodes[grandParent].right = sibling;
+        nodes[sibling].parent = grandParent;
+        refit(grandParent);
+    }
+
+    // walks up from index, rebalancing and recomputing boxes and heights
+    void refit(int index)
+    {
+        while(index >= 0)
+        {
+            index = balance(index);
+            Node &node = nodes[index];
+            node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+            node.box = nodes[node.left].box;
+            node.box.add(nodes[node.right].box);
+            index = node.parent;
+        }
+    }
+
+    // rotates the taller grandchild up when the children of a differ in height by more than one.
+    // returns the node now at a's place.
+    int balance(int a)
+    {
+        if(nodes[a].leaf() || nodes[a].height < 2)
+            return a;
+        int b = nodes[a].left, c = nodes[a].right;
+        int difference = nodes[c].height - nodes[b].height;
+        if(difference > 1)
+            return rotate(a, c, true);
+        if(difference < -1)
+            return rotate(a, b, false);
+        return a;
+    }
+
+    // lifts child, the taller child of a, above a. right tells which side of a it was on.
+    int rotate(int a, int child, bool right)
+    {
+        int f = nodes[child].left, g = nodes[child].right;
+
+        // child takes a's place
+        nodes[child].left = a;
+        nodes[child].parent = nodes[a].parent;
+        nodes[a].parent = child;
+        if(nodes[child].parent < 0)
+            root = child;
+        else if(nodes[nodes[child].parent].left == a)
+            nodes[nodes[child].parent].left = child;
+        else
+            nodes[nodes[child].parent].right = child;
+
+        // the taller grandchild stays with child, the other one moves under a
+        int keep = nodes[f].height > nodes[g].height ? f : g;
+        int move = keep == f ? g : f;
+        nodes[child].right = keep;
+        if(right)
+            nodes[a].right = move;
+        else
+            nodes[a].left = move;
+        nodes[move].parent = a;
+
+        nodes[a].box = nodes[nodes[a].left].box;
+        nodes[a].box.add(nodes[nodes[a].right].box);
+        nodes[a].height = 1 + std::max(nodes[nodes[a].left].height, nodes[nodes[a].right].height);
+        nodes[child].box = nodes[a].box;
+        nodes[child].box.add(nodes[keep].box);
+        nodes[child].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+        return child;
+    }
+};
+
+#endif
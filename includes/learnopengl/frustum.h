@@ -0,0 +1,251 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_AVX
+#define FRUSTUM_SSE
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// axis aligned bounding box. a default constructed box is empty and grows with add()
+struct AABB
+{
+    glm::vec3 lower, upper;
+
+    AABB() : lower(FLT_MAX), upper(-FLT_MAX) {}
+    AABB(const glm::vec3 &lower, const glm::vec3 &upper) : lower(lower), upper(upper) {}
+
+    bool empty() const
+    {
+        return lower.x > upper.x;
+    }
+
+    void add(const glm::vec3 &point)
+    {
+        lower = glm::min(lower, point);
+        upper = glm::max(upper, point);
+    }
+
+    void add(const AABB &box)
+    {
+        lower = glm::min(lower, box.lower);
+        upper = glm::max(upper, box.upper);
+    }
+
+    bool contains(const AABB &box) const
+    {
+        return glm::all(glm::lessThanEqual(lower, box.lower)) && glm::all(glm::greaterThanEqual(upper, box.upper));
+    }
+
+    glm::vec3 center() const
+    {
+        return (lower + upper) * 0.5f;
+    }
+
+    glm::vec3 extent() const
+    {
+        return (upper - lower) * 0.5f;
+    }
+
+    // half the surface area, enough to compare boxes
+    float area() const
+    {
+        glm::vec3 size = upper - lower;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+
+    AABB expanded(float margin) const
+    {
+        return AABB(lower - glm::vec3(margin), upper + glm::vec3(margin));
+    }
+
+    // box around this one after transform (Arvo, "Transforming Axis-Aligned Bounding Boxes", Graphics Gems 1990)
+    AABB transformed(const glm::mat4 &transform) const
+    {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(this->center(), 1.0f));
+        glm::vec3 extent = this->extent();
+        glm::vec3 radius(0.0f);
+        for(int column = 0; column < 3; column++)
+            radius += glm::abs(glm::vec3(transform[column])) * extent[column];
+        return AABB(center - radius, center + radius);
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+// box and sphere around the positions of vertices. the sphere is centered on the box
+// but only reaches as far as the farthest vertex, which is tighter than the box corners.
+template <typename VertexType>
+void computeBounds(const std::vector<VertexType> &vertices, AABB &box, BoundingSphere &sphere)
+{
+    box = AABB();
+    for(size_t i = 0; i < vertices.size(); i++)
+        box.add(vertices[i].Position);
+    sphere.center = box.empty() ? glm::vec3(0.0f) : box.center();
+    float radius2 = 0.0f;
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        glm::vec3 d = vertices[i].Position - sphere.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radius2);
+}
+
+enum FrustumTest
+{
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
+// the six planes of a view frustum in world space, pointing inwards
+// (Gribb and Hartmann, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix", 2001)
+struct Frustum
+{
+    glm::vec4 planes[6];    // left, right, bottom, top, near, far. xyz is the unit normal
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        glm::vec4 rows[4];
+        for(int r = 0; r < 4; r++)
+            rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+        for(int i = 0; i < 3; i++)
+        {
+            planes[2 * i] = rows[3] + rows[i];
+            planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for(int i = 0; i < 6; i++)
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+
+    FrustumTest test(const AABB &box) const
+    {
+        glm::vec3 center = box.center(), extent = box.extent();
+        FrustumTest result = FRUSTUM_INSIDE;
+        for(int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal(planes[i]);
+            float distance = glm::dot(normal, center) + planes[i].w;
+            float radius = glm::dot(glm::abs(normal), extent);
+            if(distance < -radius)
+                return FRUSTUM_OUTSIDE;
+            if(distance < radius)
+                result = FRUSTUM_INTERSECTS;
+        }
+        return result;
+    }
+
+    bool intersects(const AABB &box) const
+    {
+        return test(box) != FRUSTUM_OUTSIDE;
+    }
+
+    bool intersects(const BoundingSphere &sphere) const
+    {
+        for(int i = 0; i < 6; i++)
+            if(glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+                return false;
+        return true;
+    }
+};
+
+// writes 1 to visible[i] for every boxes[i] that is not completely outside one plane, 0 otherwise.
+// with SSE every plane is tested against four boxes at once (eight with AVX), the boxes being transposed into
+// center and extent registers first. the test is conservative like Frustum::test: boxes near a corner may pass.
+inline void cullBoxes(const Frustum &frustum, const AABB *boxes, size_t count, unsigned char *visible)
+{
+    size_t i = 0;
+#ifdef FRUSTUM_AVX
+    {
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 center[3], extent[3];
+            for(int axis = 0; axis < 3; axis++)
+            {
+                const AABB *b = boxes + i;
+                __m256 lower = _mm256_setr_ps(b[0].lower[axis], b[1].lower[axis], b[2].lower[axis], b[3].lower[axis],
+                                              b[4].lower[axis], b[5].lower[axis], b[6].lower[axis], b[7].lower[axis]);
+                __m256 upper = _mm256_setr_ps(b[0].upper[axis], b[1].upper[axis], b[2].upper[axis], b[3].upper[axis],
+                                              b[4].upper[axis], b[5].upper[axis], b[6].upper[axis], b[7].upper[axis]);
+                center[axis] = _mm256_mul_ps(_mm256_add_ps(lower, upper), half);
+                extent[axis] = _mm256_mul_ps(_mm256_sub_ps(upper, lower), half);
+            }
+
+            __m256 outside = _mm256_setzero_ps();
+            for(int p = 0; p < 6; p++)
+            {
+                const glm::vec4 &plane = frustum.planes[p];
+                __m256 distance = _mm256_set1_ps(plane.w);
+                for(int axis = 0; axis < 3; axis++)
+                {
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane[axis]), center[axis]));
+                    distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(std::fabs(plane[axis])), extent[axis]));
+                }
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+            for(int k = 0; k < 8; k++)
+                visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+        }
+    }
+#endif
+#ifdef FRUSTUM_SSE
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 lower[3], upper[3];
+        for(int axis = 0; axis < 3; axis++)
+        {
+            lower[axis] = _mm_setr_ps(boxes[i].lower[axis], boxes[i + 1].lower[axis], boxes[i + 2].lower[axis], boxes[i + 3].lower[axis]);
+            upper[axis] = _mm_setr_ps(boxes[i].upper[axis], boxes[i + 1].upper[axis], boxes[i + 2].upper[axis], boxes[i + 3].upper[axis]);
+        }
+        __m128 center[3], extent[3];
+        for(int axis = 0; axis < 3; axis++)
+        {
+            center[axis] = _mm_mul_ps(_mm_add_ps(lower[axis], upper[axis]), half);
+            extent[axis] = _mm_mul_ps(_mm_sub_ps(upper[axis], lower[axis]), half);
+        }
+
+        __m128 outside = _mm_setzero_ps();
+        for(int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            // distance + radius < 0 means the whole box is behind the plane
+            __m128 distance = _mm_set1_ps(plane.w);
+            for(int axis = 0; axis < 3; axis++)
+            {
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[axis]), center[axis]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(std::fabs(plane[axis])), extent[axis]));
+            }
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for(int k = 0; k < 4; k++)
+            visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+    }
+#endif
+    for(; i < count; i++)
+        visible[i] = frustum.intersects(boxes[i]) ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef HIZ_BUFFER_H
+#define HIZ_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+
+// hierarchical depth buffer (Greene, Kass and Miller, "Hierarchical Z-Buffer Visibility", 1993) built on GL 4.3:
+// the depth buffer is copied into a texture and reduced by a compute shader (hiz.cs) into a mip chain where every
+// texel holds the farthest depth of the pixels below it. a box whose nearest depth lies behind the farthest depth
+// of the two by two texels covering its screen rectangle is hidden.
+// level 0 is the largest power of two that fits into the depth buffer, so every level halves the one above it
+// exactly and a screen rectangle maps onto texels without rounding.
+class HiZBuffer
+{
+public:
+    HiZBuffer() : depthTexture(0), pyramid(0), depthWidth(0), depthHeight(0), width(0), height(0), levels(0), built(false) {}
+
+    ~HiZBuffer()
+    {
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &pyramid);
+    }
+
+    // copies the depth of the current read framebuffer, framebufferWidth by framebufferHeight pixels, and reduces it.
+    // viewProjection is the matrix the depth was rendered with, culling reprojects into it.
+    void build(Shader &reduceShader, int framebufferWidth, int framebufferHeight, const glm::mat4 &viewProjection)
+    {
+        if(framebufferWidth <= 0 || framebufferHeight <= 0)
+            return;
+        if(framebufferWidth != depthWidth || framebufferHeight != depthHeight)
+            allocate(framebufferWidth, framebufferHeight);
+        matrix = viewProjection;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, depthWidth, depthHeight);
+
+        reduceShader.use();
+        reduceShader.setInt("source", 0);
+        int sourceWidth = depthWidth, sourceHeight = depthHeight;
+        for(int level = 0; level < levels; level++)
+        {
+            int levelWidth = std::max(width >> level, 1), levelHeight = std::max(height >> level, 1);
+            // level 0 reads the depth copy, every other level the one above it
+            glBindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture : pyramid);
+            reduceShader.setInt("sourceLevel", level == 0 ? 0 : level - 1);
+            reduceShader.setVec2("sourceSize", glm::vec2(sourceWidth, sourceHeight));
+            reduceShader.setVec2("size", glm::vec2(levelWidth, levelHeight));
+            glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glDispatchCompute((levelWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (levelHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+            sourceWidth = levelWidth;
+            sourceHeight = levelHeight;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        built = true;
+    }
+
+    // false until the first build(), nothing can be culled against it then
+    bool valid() const
+    {
+        return built;
+    }
+
+    unsigned int texture() const
+    {
+        return pyramid;
+    }
+
+    // size of level 0
+    glm::ivec2 size() const
+    {
+        return glm::ivec2(width, height);
+    }
+
+    int levelCount() const
+    {
+        return levels;
+    }
+
+    const glm::mat4 &viewProjection() const
+    {
+        return matrix;
+    }
+
+private:
+    // threads per side of a work group of hiz.cs
+    static const int REDUCE_GROUP_SIZE = 8;
+
+    unsigned int depthTexture, pyramid;
+    int depthWidth, depthHeight;
+    int width, height, levels;
+    bool built;
+    glm::mat4 matrix;
+
+    HiZBuffer(const HiZBuffer&);
+    HiZBuffer &operator=(const HiZBuffer&);
+
+    static int previousPowerOfTwo(int value)
+    {
+        int power = 1;
+        while(power * 2 <= value)
+            power *= 2;
+        return power;
+    }
+
+    void allocate(int framebufferWidth, int framebufferHeight)
+    {
+        glDeleteTextures(1, &depthTexture);
+        glDeleteTextures(1, &pyramid);
+        depthWidth = framebufferWidth;
+        depthHeight = framebufferHeight;
+        width = previousPowerOfTwo(depthWidth);
+        height = previousPowerOfTwo(depthHeight);
+        levels = 1;
+        while((width >> levels) > 0 || (height >> levels) > 0)
+            levels++;
+
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, depthWidth, depthHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        glGenTextures(1, &pyramid);
+        glBindTexture(GL_TEXTURE_2D, pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        built = false;
+    }
+};
+
+#endif
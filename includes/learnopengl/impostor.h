@@ -0,0 +1,254 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// one copy of the impostor: where it stands, how large it is and how far it is turned about the y axis
+struct ImpostorInstance
+{
+    glm::vec3 position;
+    float scale;
+    float yaw;          // radians
+};
+
+// direction on the unit sphere for a point of the octahedral square [-1, 1]^2, +y in the middle and -y in the corners.
+// impostor.vs has the same mapping.
+inline glm::vec3 octahedronDirection(const glm::vec2 &uv)
+{
+    glm::vec3 v(uv.x, 1.0f - std::fabs(uv.x) - std::fabs(uv.y), uv.y);
+    if(v.y < 0.0f)
+    {
+        float x = (1.0f - std::fabs(v.z)) * (v.x >= 0.0f ? 1.0f : -1.0f);
+        float z = (1.0f - std::fabs(v.x)) * (v.z >= 0.0f ? 1.0f : -1.0f);
+        v.x = x;
+        v.z = z;
+    }
+    return glm::normalize(v);
+}
+
+// octahedral impostor (after Brucks, "Octahedral Impostors", 2018): the model is rendered once from frames x frames
+// directions spread evenly over the sphere by the octahedral mapping, each into its own cell of an atlas.
+// a copy is then drawn as one quad: impostor.vs picks the captured direction closest to the one it is seen from,
+// turns the quad the way that frame was captured and samples its cell. billboarding happens on the gpu, the cpu
+// only uploads a position, a scale and a turn per copy, so thousands of them cost about as much as sprites.
+class Impostor
+{
+public:
+    Impostor(int frames = 12, int frameSize = 128)
+        : frames(frames), frameSize(frameSize), atlas(0), framebuffer(0), depth(0), nextFrame(0), VAO(0), quadVBO(0), instanceVBO(0),
+          instanceCount(0), center(0.0f), radius(1.0f) {}
+
+    ~Impostor()
+    {
+        glDeleteTextures(1, &atlas);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &quadVBO);
+        glDeleteBuffers(1, &instanceVBO);
+    }
+
+    // starts a capture of what lies in bounds, a model space box, into a cleared atlas. the frames are then
+    // rendered by captureFrames(), a few per call, so the capture can be spread over as many frames of the
+    // application as it likes. the current framebuffer and viewport are left as they are.
+    void beginCapture(const AABB &bounds)
+    {
+        center = bounds.center();
+        radius = std::max(glm::length(bounds.extent()), 1e-4f);
+        nextFrame = 0;
+
+        int size = frames * frameSize;
+        if(!atlas)
+            glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // the cells are small, deeper levels would blend neighbouring frames into each other
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, std::max(0, (int)std::log2((float)frameSize) - 3));
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        if(!framebuffer)
+        {
+            glGenFramebuffers(1, &framebuffer);
+            glGenRenderbuffers(1, &depth);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::IMPOSTOR:: atlas framebuffer is not complete" << std::endl;
+        // every frame draws into its own cell, so one clear up front covers all of them
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    }
+
+    // renders the next count frames of the capture started by beginCapture(). draw is called once per frame with
+    // the view and projection to use. the last frame builds the mip levels and gives back the capture framebuffer.
+    // returns true once the atlas is complete, until then Draw() renders nothing.
+    // the current framebuffer and viewport are restored afterwards.
+    bool captureFrames(const std::function<void(const glm::mat4 &view, const glm::mat4 &projection)> &draw, int count)
+    {
+        if(captured() || !framebuffer)
+            return captured();
+        GLint previousFramebuffer = 0, viewport[4];
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        // orthographic, so every frame covers the bounding sphere exactly and the quad can be sized by its radius
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+        for(int last = std::min(nextFrame + count, frames * frames); nextFrame < last; nextFrame++)
+        {
+            int x = nextFrame % frames, y = nextFrame / frames;
+            glm::vec3 direction = frameDirection(x, y);
+            glm::mat4 view = glm::lookAt(center + direction * 2.0f * radius, center, upFor(direction));
+            glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+            draw(view, projection);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if(!captured())
+            return false;
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &framebuffer);
+        depth = framebuffer = 0;
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return true;
+    }
+
+    // renders every frame into the atlas at once, see beginCapture() and captureFrames()
+    void capture(const std::function<void(const glm::mat4 &view, const glm::mat4 &projection)> &draw, const AABB &bounds)
+    {
+        beginCapture(bounds);
+        captureFrames(draw, frames * frames);
+    }
+
+    // every frame of the capture is in the atlas
+    bool captured() const
+    {
+        return atlas && nextFrame >= frames * frames;
+    }
+
+    int frameCount() const
+    {
+        return frames * frames;
+    }
+
+    // replaces the copies Draw() renders
+    void setInstances(const std::vector<ImpostorInstance> &instances)
+    {
+        if(!VAO)
+            setupQuad();
+        instanceCount = instances.size();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(ImpostorInstance), instances.empty() ? NULL : &instances[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // one instanced draw of all copies with shader (impostor.vs / impostor.fs)
+    void Draw(Shader &shader, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &cameraPosition)
+    {
+        if(!captured() || instanceCount == 0)
+            return;
+        shader.use();
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+        shader.setVec3("cameraPosition", cameraPosition);
+        shader.setVec3("center", center);
+        shader.setFloat("radius", radius);
+        shader.setInt("frames", frames);
+        shader.setInt("atlas", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instanceCount);
+        glBindVertexArray(0);
+    }
+
+    unsigned int texture() const
+    {
+        return atlas;
+    }
+
+    // video memory of the atlas, without its few mip levels
+    size_t gpuBytes() const
+    {
+        size_t size = frames * frameSize;
+        return size * size * 4;
+    }
+
+private:
+    int frames, frameSize;
+    unsigned int atlas;
+    unsigned int framebuffer, depth;    // only while a capture is running
+    int nextFrame;                      // frame captureFrames() renders next
+    unsigned int VAO, quadVBO, instanceVBO;
+    unsigned int instanceCount;
+    glm::vec3 center;       // bounding sphere of the captured model, in model space
+    float radius;
+
+    Impostor(const Impostor&);
+    Impostor &operator=(const Impostor&);
+
+    // frame (x, y) is seen from this direction. the grid includes the edges of the square, so the poles and the
+    // horizon directions along the axes are captured exactly
+    glm::vec3 frameDirection(int x, int y) const
+    {
+        glm::vec2 uv = glm::vec2(x, y) / (float)(frames - 1) * 2.0f - 1.0f;
+        return octahedronDirection(uv);
+    }
+
+    // up vector of the capture camera, impostor.vs rebuilds the same basis for the quad
+    static glm::vec3 upFor(const glm::vec3 &direction)
+    {
+        return std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    void setupQuad()
+    {
+        static const float corners[] = { -1.0f, -1.0f,  1.0f, -1.0f,  -1.0f, 1.0f,  1.0f, 1.0f };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, position));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*)offsetof(ImpostorInstance, yaw));
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
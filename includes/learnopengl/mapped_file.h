@@ -0,0 +1,99 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <string>
+
+// read only view of a whole file, mapped into the address space (mmap, MapViewOfFile) instead of read into a buffer.
+// pages are only brought in when touched and come straight from the file cache, without a copy into the process.
+// data() is NULL when the file is missing, empty or can not be mapped. the view is page aligned.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path) : bytes(NULL), length(0)
+    {
+#ifdef _WIN32
+        mapping = NULL;
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if(file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER fileSize;
+        if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping == NULL)
+            return;
+        bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if(bytes)
+            length = (size_t)fileSize.QuadPart;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if(file < 0)
+            return;
+        struct stat info;
+        if(fstat(file, &info) == 0 && info.st_size > 0)
+        {
+            void *view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if(view != MAP_FAILED)
+            {
+                bytes = (const char*)view;
+                length = (size_t)info.st_size;
+            }
+        }
+        // the mapping keeps the file referenced on its own
+        close(file);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if(bytes)
+            UnmapViewOfFile(bytes);
+        if(mapping != NULL)
+            CloseHandle(mapping);
+        if(file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if(bytes)
+            munmap((void*)bytes, length);
+#endif
+    }
+
+    const char *data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    const char *bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile &operator=(const MappedFile&);
+};
+
+#endif
@@ -6,8 +6,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/frustum.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_packing.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,6 +28,27 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// setupVertexAttributes() addresses the float layout through these
+static_assert(sizeof(Vertex) == VERTEX_FLOAT_SIZE && offsetof(Vertex, Normal) == 12 && offsetof(Vertex, TexCoords) == 24 &&
+              offsetof(Vertex, Tangent) == 32 && offsetof(Vertex, Bitangent) == 44, "Vertex layout out of sync with vertex_packing.h");
+
+// one level of detail: a range of the mesh's index list, see mesh_simplifier.h
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// what a mesh keeps in system memory once its buffers are uploaded, from most to least
+enum MeshResidency {
+    MESH_KEEP_ALL,          // vertices and indices stay, e.g. for ModelBatch or the mesh cache
+    MESH_KEEP_POSITIONS,    // positions and indices only, enough for picking and bounds
+    MESH_DROP               // nothing, the gpu copy is the only one
+};
+
+// attributes of the instanced path, see Mesh::setInstanceBuffers(): a mat4 in 5 ~ 8 and an rgba tint in 9
+const GLuint INSTANCE_TRANSFORM_ATTRIBUTE = 5;
+const GLuint INSTANCE_TINT_ATTRIBUTE = 9;
+
 struct Texture {
     unsigned int id;
     string type;
@@ -35,33 +59,168 @@ class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
-    vector<unsigned int> indices;
+    vector<unsigned int> indices;   // every level of detail, one after the other
     vector<Texture>      textures;
+    vector<MeshLod>      lods;      // lods[0] is the full mesh
+    vector<glm::vec3>    positions; // only filled under MESH_KEEP_POSITIONS, vertices is empty then
+    MeshResidency        residency;
+    // model space bounds, computed before the vertices can be dropped
+    AABB                 bounds;
+    BoundingSphere       sphere;
     unsigned int VAO;
+    // gpu side layout: the vertex format asked for and the index type picked from the vertex count
+    VertexFormat format;
+    GLenum indexType;
+    // maps the stored positions onto the mesh, only differs from identity for quantized positions.
+    // shaders drawing such meshes multiply it in from the positionTransform uniform.
+    glm::mat4 positionTransform;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. lodIndexCounts splits indices into levels of detail, empty means indices is a single level.
+    // the arrays are taken by value, so callers that std::move them in hand their storage over without a copy.
+    // residency decides what is left of them once setupMesh() has uploaded the buffers.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FLOAT,
+         vector<unsigned int> lodIndexCounts = vector<unsigned int>(), MeshResidency residency = MESH_KEEP_ALL)
+        : residency(MESH_KEEP_ALL), format(format), indexType(GL_UNSIGNED_INT), positionTransform(1.0f), samplerProgram(0), vertexBytes(0), indexBytes(0)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices.swap(vertices);
+        this->indices.swap(indices);
+        this->textures.swap(textures);
+        if(lodIndexCounts.empty())
+            lodIndexCounts.push_back(this->indices.size());
+        unsigned int first = 0;
+        for(unsigned int i = 0; i < lodIndexCounts.size(); i++)
+        {
+            MeshLod lod = { first, lodIndexCounts[i] };
+            lods.push_back(lod);
+            first += lodIndexCounts[i];
+        }
+
+        computeBounds(this->vertices, bounds, sphere);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+        setResidency(residency);
+    }
+
+    // releases the cpu copies the policy does not keep. a mesh can only give data up, never get it back.
+    void setResidency(MeshResidency policy)
+    {
+        if(policy <= residency)
+            return;
+        if(policy == MESH_KEEP_POSITIONS)
+        {
+            vector<glm::vec3> kept(vertices.size());
+            for(unsigned int i = 0; i < vertices.size(); i++)
+                kept[i] = vertices[i].Position;
+            positions.swap(kept);
+        }
+        else
+        {
+            vector<glm::vec3>().swap(positions);
+            vector<unsigned int>().swap(indices);
+        }
+        vector<Vertex>().swap(vertices);
+        residency = policy;
+    }
+
+    // render the mesh at the given level of detail, clamped to the coarsest one there is
+    void Draw(Shader &shader, int lod = 0) 
+    {
+        bindTextures(shader);
+        
+        // draw mesh
+        glBindVertexArray(VAO);
+        const MeshLod &range = lods[std::min(std::max(lod, 0), (int)lods.size() - 1)];
+        glDrawElements(GL_TRIANGLES, range.indexCount, indexType, (void*)(range.firstIndex * indexSize(indexType)));
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
     }
 
-    // render the mesh
-    void Draw(Shader &shader) 
+    // renders instanceCount copies in one call. the shader reads each copy's model matrix and tint from the
+    // instance attributes, so setInstanceBuffers() has to be called first.
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, int lod = 0)
     {
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        const MeshLod &range = lods[std::min(std::max(lod, 0), (int)lods.size() - 1)];
+        glDrawElementsInstanced(GL_TRIANGLES, range.indexCount, indexType, (void*)(range.firstIndex * indexSize(indexType)), instanceCount);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // feeds the instance attributes from transforms, one glm::mat4 per instance, and tints, one glm::vec4 per instance.
+    // the buffers belong to the caller, several meshes can share them.
+    void setInstanceBuffers(unsigned int transforms, unsigned int tints)
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, transforms);
+        for(GLuint i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(INSTANCE_TRANSFORM_ATTRIBUTE + i);
+            glVertexAttribPointer(INSTANCE_TRANSFORM_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_TRANSFORM_ATTRIBUTE + i, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, tints);
+        glEnableVertexAttribArray(INSTANCE_TINT_ATTRIBUTE);
+        glVertexAttribPointer(INSTANCE_TINT_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+        glVertexAttribDivisor(INSTANCE_TINT_ATTRIBUTE, 1);
+        glBindVertexArray(0);
+    }
+
+    // video memory held by the vertex and index buffers
+    size_t gpuBytes() const
+    {
+        return vertexBytes + indexBytes;
+    }
+
+    // system memory held by the geometry arrays
+    size_t cpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) +
+               positions.capacity() * sizeof(glm::vec3) + lods.capacity() * sizeof(MeshLod);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+    // program of the shader last drawn with, 0 when there is none yet
+    unsigned int samplerProgram;
+    // sampler of every texture in that program, -1 where it has none
+    vector<UniformHandle<int> > samplerLocations;
+    UniformHandle<glm::mat4> positionTransformLocation;
+    // sizes of the gpu buffers
+    size_t vertexBytes, indexBytes;
+
+    void bindTextures(Shader &shader)
+    {
+        // sampler names only depend on the textures, so their locations are resolved once per shader
+        if(samplerProgram != shader.ID)
+            resolveSamplers(shader);
         // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            shader.set(samplerLocations[i], (int)i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+        if(format == VERTEX_PACKED_QUANTIZED)
+            shader.set(positionTransformLocation, positionTransform);
+    }
+
+    // texture i is bound to the sampler <type>N, where N counts the textures of that type (the N in diffuse_textureN)
+    void resolveSamplers(const Shader &shader)
+    {
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerLocations.resize(textures.size());
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
             if(name == "texture_diffuse")
@@ -72,26 +231,14 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // shaders are free to ignore some of the maps, so a missing sampler is not worth a warning
+            samplerLocations[i] = UniformHandle<int>(shader.location(name + number));
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        if(format == VERTEX_PACKED_QUANTIZED)
+            positionTransformLocation = shader.uniform<glm::mat4>("positionTransform");
+        samplerProgram = shader.ID;
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -101,32 +248,22 @@ private:
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
-        // load data into vertex buffers
+        // load data into vertex buffers, converted to the requested format
+        vector<unsigned char> packed;
+        packVertices(vertices, format, packed, positionTransform);
+        vertexBytes = packed.size();
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.empty() ? NULL : &packed[0], GL_STATIC_DRAW);
 
+        // 16 bit indices whenever every vertex can be addressed with them
+        packed.clear();
+        indexType = packIndices(indices, vertices.size() <= 65536, packed);
+        indexBytes = packed.size();
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, packed.size(), packed.empty() ? NULL : &packed[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        setupVertexAttributes(format);
 
         glBindVertexArray(0);
     }
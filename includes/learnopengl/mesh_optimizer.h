@@ -0,0 +1,287 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// import time optimizations for indexed triangle lists, after Sander, Nehab and Barczak,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (2007):
+//   1. weld vertices that are bitwise identical
+//   2. reorder triangles for the post transform cache (tipsify)
+//   3. reorder the clusters tipsify produced so that outward facing ones come first (overdraw)
+//   4. renumber vertices in order of first use (vertex fetch locality)
+// the quality measure is ACMR, average cache miss ratio: vertex shader invocations per triangle
+// on a FIFO cache of MESH_OPTIMIZER_CACHE_SIZE entries. 3.0 is the worst case, 0.5 the limit for big regular meshes.
+const unsigned int MESH_OPTIMIZER_CACHE_SIZE = 16;
+
+struct MeshOptimizerStats
+{
+    unsigned int verticesBefore;
+    unsigned int verticesAfter;
+    float acmrBefore;
+    float acmrAfter;
+};
+
+// transformed vertices per triangle on a FIFO cache of cacheSize entries
+inline float meshACMR(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE)
+{
+    if(indices.size() < 3)
+        return 0.0f;
+    std::vector<unsigned int> insertedAt(vertexCount, 0);  // miss counter value when the vertex entered the cache, 0 = never
+    unsigned int misses = 0;
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if(insertedAt[v] == 0 || misses - insertedAt[v] >= cacheSize)
+        {
+            misses++;
+            insertedAt[v] = misses;
+        }
+    }
+    return (float)misses / (indices.size() / 3);
+}
+
+// merges bitwise identical vertices, rewriting indices. returns the new vertex count.
+template <typename VertexType>
+unsigned int weldVertices(std::vector<VertexType> &vertices, std::vector<unsigned int> &indices)
+{
+    struct Hash
+    {
+        const std::vector<VertexType> *vertices;
+        size_t operator()(unsigned int i) const
+        {
+            // FNV-1a over the raw bytes
+            const unsigned char *bytes = (const unsigned char*)&(*vertices)[i];
+            size_t hash = 2166136261u;
+            for(size_t b = 0; b < sizeof(VertexType); b++)
+                hash = (hash ^ bytes[b]) * 16777619u;
+            return hash;
+        }
+    };
+    struct Equal
+    {
+        const std::vector<VertexType> *vertices;
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(VertexType)) == 0;
+        }
+    };
+
+    Hash hash = { &vertices };
+    Equal equal = { &vertices };
+    std::unordered_map<unsigned int, unsigned int, Hash, Equal> unique(vertices.size(), hash, equal);
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<VertexType> welded;
+    welded.reserve(vertices.size());
+    for(unsigned int i = 0; i < vertices.size(); i++)
+    {
+        typename std::unordered_map<unsigned int, unsigned int, Hash, Equal>::iterator found = unique.find(i);
+        if(found != unique.end())
+        {
+            remap[i] = remap[found->first];
+            continue;
+        }
+        unique.insert(std::make_pair(i, 0u));
+        remap[i] = welded.size();
+        welded.push_back(vertices[i]);
+    }
+    for(size_t i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+// tipsify: fans around one vertex at a time and picks the next fanning vertex among the ones still in the cache.
+// clusters receives the triangle offsets where the walk had to jump (hard boundaries), starting with 0.
+inline void tipsifyTriangles(const std::vector<unsigned int> &indices, unsigned int vertexCount, unsigned int cacheSize,
+                             std::vector<unsigned int> &result, std::vector<unsigned int> &clusters)
+{
+    const unsigned int triangleCount = indices.size() / 3;
+    result.clear();
+    result.reserve(indices.size());
+    clusters.clear();
+    if(triangleCount == 0)
+        return;
+
+    // vertex -> triangle adjacency in compressed rows
+    std::vector<unsigned int> live(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(indices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+        live[indices[i]]++;
+    for(unsigned int v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + live[v];
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = i / 3;
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fan = indices[0];
+    clusters.push_back(0);
+
+    while(fan >= 0)
+    {
+        candidates.clear();
+        for(unsigned int a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            unsigned int t = adjacency[a];
+            if(emitted[t])
+                continue;
+            for(int c = 0; c < 3; c++)
+            {
+                unsigned int v = indices[3 * t + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if(time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the candidate that stays in the cache longest while its remaining triangles are emitted
+        int next = -1;
+        int best = -1;
+        for(size_t i = 0; i < candidates.size(); i++)
+        {
+            unsigned int v = candidates[i];
+            if(live[v] == 0)
+                continue;
+            int priority = 0;
+            if(time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if(priority > best)
+            {
+                best = priority;
+                next = v;
+            }
+        }
+        if(next < 0)
+        {
+            // dead end: back up through recently used vertices, then scan forward in input order
+            while(!deadEnd.empty() && next < 0)
+            {
+                unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if(live[v] > 0)
+                    next = v;
+            }
+            while(next < 0 && cursor < indices.size())
+            {
+                if(live[indices[cursor]] > 0)
+                    next = indices[cursor];
+                cursor++;
+            }
+            if(next >= 0)
+                clusters.push_back(result.size() / 3);
+        }
+        fan = next;
+    }
+}
+
+// sorts the clusters so that the ones facing away from the mesh center are drawn first:
+// they occlude the inward facing ones behind them, which then fail the depth test instead of being shaded.
+template <typename VertexType>
+void sortClustersForOverdraw(const std::vector<VertexType> &vertices, std::vector<unsigned int> &indices, const std::vector<unsigned int> &clusters)
+{
+    const unsigned int triangleCount = indices.size() / 3;
+    if(clusters.size() < 2)
+        return;
+
+    glm::vec3 center(0.0f);
+    float totalArea = 0.0f;
+    std::vector<glm::vec3> centroids(clusters.size()), normals(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for(unsigned int t = clusters[c]; t < end; t++)
+        {
+            const glm::vec3 &a = vertices[indices[3 * t]].Position;
+            const glm::vec3 &b = vertices[indices[3 * t + 1]].Position;
+            const glm::vec3 &d = vertices[indices[3 * t + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, d - a);  // twice the area, pointing along the face normal
+            float weight = glm::length(n);
+            centroid += (a + b + d) / 3.0f * weight;
+            normal += n;
+            area += weight;
+        }
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = normal;
+        center += centroid;
+        totalArea += area;
+    }
+    if(totalArea > 0.0f)
+        center /= totalArea;
+
+    std::vector<std::pair<float, unsigned int> > order(clusters.size());
+    for(size_t c = 0; c < clusters.size(); c++)
+    {
+        float length = glm::length(normals[c]);
+        order[c] = std::make_pair(length > 0.0f ? -glm::dot(centroids[c] - center, normals[c] / length) : 0.0f, (unsigned int)c);
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    std::vector<unsigned int> sorted;
+    sorted.reserve(indices.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        unsigned int c = order[i].second;
+        unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        sorted.insert(sorted.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+    }
+    indices.swap(sorted);
+}
+
+// renumbers vertices in the order the index buffer first touches them and drops unreferenced ones
+template <typename VertexType>
+void reorderVerticesForFetch(std::vector<VertexType> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<VertexType> ordered;
+    ordered.reserve(vertices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int &target = remap[indices[i]];
+        if(target == unused)
+        {
+            target = ordered.size();
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+    vertices.swap(ordered);
+}
+
+// runs every step on a triangle list. lists that are not pure triangles are left alone.
+template <typename VertexType>
+MeshOptimizerStats optimizeMesh(std::vector<VertexType> &vertices, std::vector<unsigned int> &indices)
+{
+    MeshOptimizerStats stats;
+    stats.verticesBefore = vertices.size();
+    stats.acmrBefore = meshACMR(indices, vertices.size());
+    if(indices.size() % 3 == 0 && !indices.empty())
+    {
+        weldVertices(vertices, indices);
+        std::vector<unsigned int> ordered, clusters;
+        tipsifyTriangles(indices, vertices.size(), MESH_OPTIMIZER_CACHE_SIZE, ordered, clusters);
+        indices.swap(ordered);
+        sortClustersForOverdraw(vertices, indices, clusters);
+        reorderVerticesForFetch(vertices, indices);
+    }
+    stats.verticesAfter = vertices.size();
+    stats.acmrAfter = meshACMR(indices, vertices.size());
+    return stats;
+}
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// quadric error simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997)
+// restricted to half edge collapses: a vertex is merged into one of its neighbours, so every level of detail
+// is just another index list over the same vertex buffer.
+// vertices on the border of the mesh (where its material ends) and on uv seams (one position, several vertices)
+// never move, so the outline, the material boundaries and the texture layout stay intact.
+const int MESH_MAX_LODS = 4;
+
+// the error each level may add, relative to the size of the mesh, and the share of triangles it aims for
+const float MESH_LOD_ERROR[MESH_MAX_LODS] = { 0.0f, 0.01f, 0.025f, 0.05f };
+const float MESH_LOD_TRIANGLES[MESH_MAX_LODS] = { 1.0f, 0.5f, 0.25f, 0.125f };
+
+// weighted sum of squared distances to a set of planes, stored as the upper half of the symmetric 4x4 matrix
+struct Quadric
+{
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double w;   // total weight, turns the sum back into a mean squared distance
+
+    Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), w(0) {}
+
+    // the plane through p with unit normal n, weighted
+    Quadric(const glm::vec3 &n, const glm::vec3 &p, double weight)
+    {
+        double a = n.x, b = n.y, c = n.z, d = -glm::dot(n, p);
+        a2 = a * a * weight; ab = a * b * weight; ac = a * c * weight; ad = a * d * weight;
+        b2 = b * b * weight; bc = b * c * weight; bd = b * d * weight;
+        c2 = c * c * weight; cd = c * d * weight;
+        d2 = d * d * weight;
+        w = weight;
+    }
+
+    Quadric &operator+=(const Quadric &q)
+    {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+        bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+        w += q.w;
+        return *this;
+    }
+
+    // mean squared distance of p to the planes
+    double error(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+                     b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+                     c2 * z * z + 2 * cd * z + d2;
+        return w > 0.0 ? std::max(sum, 0.0) / w : 0.0;
+    }
+};
+
+// simplifies the triangle list indices towards targetIndexCount, never exceeding maxError (a distance in model units).
+// the result only references vertices of the input.
+template <typename VertexType>
+std::vector<unsigned int> simplifyMesh(const std::vector<VertexType> &vertices, const std::vector<unsigned int> &indices,
+                                       size_t targetIndexCount, float maxError)
+{
+    std::vector<unsigned int> result(indices);
+    const size_t vertexCount = vertices.size();
+    if(indices.size() % 3 != 0 || result.size() <= targetIndexCount)
+        return result;
+
+    // 1. locked vertices: uv seams share a position with another vertex, borders have an edge without a twin
+    std::vector<bool> locked(vertexCount, false);
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                glm::vec3 q = p + glm::vec3(0.0f);  // -0 and +0 compare equal, so they have to hash equal too
+                unsigned int bits[3];
+                memcpy(bits, &q, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> first;
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            std::pair<typename std::unordered_map<glm::vec3, unsigned int, PositionHash>::iterator, bool> inserted =
+                first.insert(std::make_pair(vertices[v].Position, v));
+            if(!inserted.second)
+                locked[v] = locked[inserted.first->second] = true;
+        }
+
+        // directed edges: a border edge has no opposite, a non manifold one shows up more than once
+        std::unordered_map<unsigned long long, unsigned int> edges;
+        for(size_t i = 0; i < result.size(); i += 3)
+            for(int k = 0; k < 3; k++)
+                edges[((unsigned long long)result[i + k] << 32) | result[i + (k + 1) % 3]]++;
+        for(std::unordered_map<unsigned long long, unsigned int>::iterator edge = edges.begin(); edge != edges.end(); ++edge)
+        {
+            unsigned int a = (unsigned int)(edge->first >> 32), b = (unsigned int)edge->first;
+            std::unordered_map<unsigned long long, unsigned int>::iterator twin = edges.find(((unsigned long long)b << 32) | a);
+            if(edge->second > 1 || twin == edges.end() || twin->second != 1)
+                locked[a] = locked[b] = true;
+        }
+    }
+
+    // 2. one quadric per vertex from the planes of its triangles, weighted by area
+    std::vector<Quadric> quadrics(vertexCount);
+    for(size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::vec3 &p0 = vertices[result[i]].Position;
+        const glm::vec3 &p1 = vertices[result[i + 1]].Position;
+        const glm::vec3 &p2 = vertices[result[i + 2]].Position;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if(area <= 0.0f)
+            continue;
+        Quadric q(n / area, p0, area * 0.5);
+        for(int k = 0; k < 3; k++)
+            quadrics[result[i + k]] += q;
+    }
+
+    // 3. passes of independent collapses, cheapest first, until the target or the error bound is reached
+    const double maxCost = (double)maxError * maxError;
+    std::vector<unsigned int> remap(vertexCount), offsets(vertexCount + 1), adjacency;
+    std::vector<bool> touched(vertexCount);
+    std::vector<std::pair<double, std::pair<unsigned int, unsigned int> > > collapses;
+    for(int pass = 0; pass < 64 && result.size() > targetIndexCount; pass++)
+    {
+        // vertex -> triangle adjacency of the current list
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for(size_t i = 0; i < result.size(); i++)
+            offsets[result[i] + 1]++;
+        for(size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = i / 3;
+
+        // cheapest target of every movable vertex
+        std::vector<double> bestCost(vertexCount, -1.0);
+        std::vector<unsigned int> bestTarget(vertexCount);
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            for(int k = 0; k < 3; k++)
+            {
+                for(int side = 1; side < 3; side++)
+                {
+                    unsigned int v = result[i + k], u = result[i + (k + side) % 3];
+                    if(locked[v])
+                        continue;
+                    Quadric q = quadrics[v];
+                    q += quadrics[u];
+                    double cost = q.error(vertices[u].Position);
+                    if(bestCost[v] < 0.0 || cost < bestCost[v])
+                    {
+                        bestCost[v] = cost;
+                        bestTarget[v] = u;
+                    }
+                }
+            }
+        }
+        collapses.clear();
+        for(unsigned int v = 0; v < vertexCount; v++)
+            if(bestCost[v] >= 0.0 && bestCost[v] <= maxCost)
+                collapses.push_back(std::make_pair(bestCost[v], std::make_pair(v, bestTarget[v])));
+        std::sort(collapses.begin(), collapses.end());
+
+        for(unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t triangles = result.size() / 3;
+        size_t collapsed = 0;
+        for(size_t c = 0; c < collapses.size() && triangles * 3 > targetIndexCount; c++)
+        {
+            unsigned int v = collapses[c].second.first, u = collapses[c].second.second;
+            if(touched[v] || touched[u])
+                continue;
+
+            // reject collapses that fold a triangle over or leave a sliver
+            bool valid = true;
+            unsigned int removed = 0;
+            for(unsigned int a = offsets[v]; a < offsets[v + 1] && valid; a++)
+            {
+                const unsigned int *t = &result[3 * adjacency[a]];
+                if(t[0] == u || t[1] == u || t[2] == u)
+                {
+                    removed++;
+                    continue;
+                }
+                glm::vec3 p[3], q[3];
+                for(int k = 0; k < 3; k++)
+                {
+                    p[k] = vertices[t[k]].Position;
+                    q[k] = t[k] == v ? vertices[u].Position : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if(glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+                    valid = false;
+            }
+            if(!valid)
+                continue;
+
+            remap[v] = u;
+            quadrics[u] += quadrics[v];
+            // everything around v changes shape, so its one ring waits for the next pass
+            for(unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+                for(int k = 0; k < 3; k++)
+                    touched[result[3 * adjacency[a] + k]] = true;
+            triangles -= removed;
+            collapsed++;
+        }
+        if(collapsed == 0)
+            break;
+
+        size_t out = 0;
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+            result[out++] = a;
+            result[out++] = b;
+            result[out++] = c;
+        }
+        result.resize(out);
+    }
+    return result;
+}
+
+// appends up to MESH_MAX_LODS - 1 simplified levels to indices, each reordered for the vertex cache.
+// lodIndexCounts receives the index count of every level, level 0 being the original list.
+// levels that would not save at least a tenth of their parent's triangles are not worth a draw range and are skipped.
+template <typename VertexType>
+void buildMeshLods(const std::vector<VertexType> &vertices, std::vector<unsigned int> &indices, std::vector<unsigned int> &lodIndexCounts)
+{
+    lodIndexCounts.assign(1, indices.size());
+    if(vertices.empty() || indices.size() % 3 != 0)
+        return;
+
+    glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+    for(size_t i = 1; i < vertices.size(); i++)
+    {
+        lower = glm::min(lower, vertices[i].Position);
+        upper = glm::max(upper, vertices[i].Position);
+    }
+    float size = glm::length(upper - lower);
+    size_t baseTriangles = indices.size() / 3;
+
+    std::vector<unsigned int> parent(indices);
+    for(int level = 1; level < MESH_MAX_LODS; level++)
+    {
+        size_t target = (size_t)(baseTriangles * MESH_LOD_TRIANGLES[level]) * 3;
+        std::vector<unsigned int> simplified = simplifyMesh(vertices, parent, target, size * MESH_LOD_ERROR[level]);
+        if(simplified.empty() || simplified.size() * 10 > parent.size() * 9)
+            break;
+        std::vector<unsigned int> ordered, clusters;
+        tipsifyTriangles(simplified, vertices.size(), MESH_OPTIMIZER_CACHE_SIZE, ordered, clusters);
+        indices.insert(indices.end(), ordered.begin(), ordered.end());
+        lodIndexCounts.push_back(ordered.size());
+        parent.swap(simplified);
+    }
+}
+
+// fraction of a threshold the size has to cross before lodForScreenSize() leaves the current level
+const float MESH_LOD_HYSTERESIS = 0.15f;
+
+// full detail down to fullDetailPixels, then one level per halving of the size
+inline int lodForRadius(float radiusPixels, float fullDetailPixels, int lodCount)
+{
+    int lod = 0;
+    while(lod + 1 < lodCount && radiusPixels < fullDetailPixels)
+    {
+        radiusPixels *= 2.0f;
+        lod++;
+    }
+    return lod;
+}
+
+// level of detail for an object whose bounding sphere covers radiusPixels on screen. given the level in use,
+// a new one is only picked once the size is past its threshold by MESH_LOD_HYSTERESIS, so an object resting
+// on a threshold does not flip between two levels every frame
+inline int lodForScreenSize(float radiusPixels, float fullDetailPixels, int lodCount, int currentLod = -1)
+{
+    int lod = lodForRadius(radiusPixels, fullDetailPixels, lodCount);
+    if(currentLod < 0 || lod == currentLod)
+        return lod;
+    // finer levels have to be earned by a larger size, coarser ones by a smaller one
+    float band = lod < currentLod ? 1.0f / (1.0f + MESH_LOD_HYSTERESIS) : 1.0f + MESH_LOD_HYSTERESIS;
+    return lodForRadius(radiusPixels * band, fullDetailPixels, lodCount);
+}
+
+#endif
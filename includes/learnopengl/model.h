@@ -10,87 +10,674 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/mapped_file.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_manager.h>
 
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// an import prints one line per model with what the optimizer and the simplifier did to it. set this to also print
+// a line per mesh, off by default since a detailed model would print hundreds of them on every load without a cache
+bool modelPrintMeshStats = false;
+
+// post processing applied to every imported model, part of the cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+// binary cache of a processed model, written next to the source as <path>.meshcache.
+// everything is 8 byte aligned and addressed by offsets from the start of the file, so once the file is mapped
+// (mapped_file.h) the vertex and index arrays are read in place. loadCache() copies each once, into its MeshData.
+//   ModelCacheHeader | source path | ModelCacheMesh[meshCount] | per mesh: vertices, indices, textures
+// textures are stored as references: (uint32 length, type) (uint32 length, path) per texture.
+const unsigned int MODEL_CACHE_VERSION = 3;  // 2: meshes are stored optimized, 3: with levels of detail
+
+struct ModelCacheHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int vertexSize;    // sizeof(Vertex), changes whenever the vertex layout does
+    unsigned int importFlags;
+    unsigned int meshCount;
+    long long sourceTime;       // modification time of the source file
+    unsigned long long sourceSize;
+    unsigned int pathLength;
+    unsigned int padding;
+};
+
+struct ModelCacheMesh
+{
+    unsigned long long vertexOffset;
+    unsigned long long indexOffset;
+    unsigned long long textureOffset;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    unsigned int textureCount;
+    unsigned int lodCount;
+    unsigned int lodIndexCounts[MESH_MAX_LODS];  // indexCount is their sum
+};
+
+// cpu side of one imported mesh. an import fills it without touching GL, the model turns it into a Mesh on the GL thread.
+struct MeshData
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<unsigned int> lodIndexCounts;
+    vector<Texture> textures;   // type and path relative to the model, ids are acquired on the GL thread
+    MeshOptimizerStats stats;   // filled by the import, not cached
+};
+
+// hand over between an import running on a worker thread and the model it fills, guarded by mutex
+struct ModelImport
+{
+    std::mutex mutex;
+    vector<MeshData> ready;     // imported meshes waiting for upload
+    bool boundsKnown;
+    glm::vec3 lower, upper;
+    bool done;
+    std::atomic<bool> cancelled;
+
+    ModelImport() : boundsKnown(false), lower(0.0f), upper(0.0f), done(false), cancelled(false) {}
+};
+
+// bytes of vertices and indices Model::update() uploads per call, so a frame never stalls on a whole model
+const size_t MODEL_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture reference this model holds on the TextureManager, released with the model
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    VertexFormat vertexFormat;  // gpu layout of every mesh, see vertex_packing.h
+    MeshResidency residency;    // what every mesh keeps in system memory after upload, see setResidency()
+    // axis aligned bounds of all meshes, known as soon as the import has read the positions
+    bool boundsKnown;
+    glm::vec3 boundsMin, boundsMax;
+    // read by update(): a model drawn only through a ModelBatch leaves its textures to the batch's arrays, its meshes
+    // then keep just the type and path of theirs. set it before the first update() of an asynchronous model
+    bool loadTextures;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // an asynchronous model returns right away and is imported on a worker thread. update() then uploads its meshes
+    // as they arrive, and until the first one does Draw() shows its bounding box instead.
+    Model(string const &path, bool gamma = false, VertexFormat format = VERTEX_FLOAT, bool async = false)
+        : gammaCorrection(gamma), vertexFormat(format), residency(MESH_KEEP_ALL), boundsKnown(false), boundsMin(0.0f), boundsMax(0.0f), loadTextures(true),
+          import(new ModelImport), instanceTransforms(0), instanceTints(0), instances(0)
+    {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+        if(async)
+        {
+            worker = std::async(std::launch::async, importModel, path, import);
+            return;
+        }
+        importModel(path, import);
+        update(~size_t(0));
+        uploadTextures();
+    }
+
+    // textures are shared through the TextureManager, so a model gives its references back instead of deleting them
+    ~Model()
+    {
+        // a running import stops after its current mesh, the future waits for it
+        if(import)
+            import->cancelled = true;
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            TextureManager::get().release(textures_loaded[i].id);
+        if(instanceTransforms)
+        {
+            glDeleteBuffers(1, &instanceTransforms);
+            glDeleteBuffers(1, &instanceTints);
+        }
+    }
+
+    // call once per frame on the GL thread while the model loads: uploads the meshes the import finished, at most
+    // budget bytes of them past the first, and the textures that are decoded. returns true once the model is complete.
+    bool update(size_t budget = MODEL_UPLOAD_BUDGET)
+    {
+        if(!import)
+            return true;
+
+        vector<MeshData> arrived;
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(import->mutex);
+            size_t count = 0, bytes = 0;
+            while(count < import->ready.size())
+            {
+                const MeshData &mesh = import->ready[count];
+                size_t size = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+                if(count > 0 && bytes + size > budget)
+                    break;
+                bytes += size;
+                count++;
+            }
+            arrived.assign(std::make_move_iterator(import->ready.begin()), std::make_move_iterator(import->ready.begin() + count));
+            import->ready.erase(import->ready.begin(), import->ready.begin() + count);
+            if(import->boundsKnown && !boundsKnown)
+            {
+                boundsKnown = true;
+                boundsMin = import->lower;
+                boundsMax = import->upper;
+            }
+            done = import->done && import->ready.empty();
+        }
+
+        if(boundsKnown && !proxy && meshes.empty() && !done)
+        {
+            proxy.reset(new Mesh(boxVertices(boundsMin, boundsMax), boxIndices(), vector<Texture>(), VERTEX_FLOAT, vector<unsigned int>(), MESH_DROP));
+            if(instanceTransforms)
+                proxy->setInstanceBuffers(instanceTransforms, instanceTints);
+        }
+        for(unsigned int i = 0; i < arrived.size(); i++)
+            addMesh(arrived[i]);
+        TextureManager::get().uploadReady();
+
+        if(done)
+        {
+            import.reset();
+            proxy.reset();
+            if(worker.valid())
+                worker.get();
+        }
+        return done;
+    }
+
+    // true once every mesh is on the gpu, textures may still be decoding
+    bool resident() const
+    {
+        return !import;
+    }
+
+    // draws the model, and thus all its meshes, at the given level of detail
+    void Draw(Shader &shader, int lod = 0)
     {
-        loadModel(path);
+        if(meshes.empty() && proxy)
+            proxy->Draw(shader);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, lod);
+    }
+
+    // uploads the copies DrawInstanced() renders: a model matrix per instance and an rgba tint multiplied into its color.
+    // tints may be empty for plain white, otherwise it has one entry per transform. can be called again to move them.
+    void setInstances(const vector<glm::mat4> &transforms, const vector<glm::vec4> &tints = vector<glm::vec4>())
+    {
+        if(!instanceTransforms)
+        {
+            glGenBuffers(1, &instanceTransforms);
+            glGenBuffers(1, &instanceTints);
+            for(unsigned int i = 0; i < meshes.size(); i++)
+                meshes[i].setInstanceBuffers(instanceTransforms, instanceTints);
+            if(proxy)
+                proxy->setInstanceBuffers(instanceTransforms, instanceTints);
+        }
+        instances = transforms.size();
+        vector<glm::vec4> white;
+        if(tints.size() != transforms.size())
+            white.assign(transforms.size(), glm::vec4(1.0f));
+        const vector<glm::vec4> &colors = white.empty() ? tints : white;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceTransforms);
+        glBufferData(GL_ARRAY_BUFFER, instances * sizeof(glm::mat4), transforms.empty() ? NULL : &transforms[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceTints);
+        glBufferData(GL_ARRAY_BUFFER, instances * sizeof(glm::vec4), colors.empty() ? NULL : &colors[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int instanceCount() const
+    {
+        return instances;
+    }
+
+    // draws every instance given to setInstances() with one call per mesh
+    void DrawInstanced(Shader &shader, int lod = 0)
+    {
+        if(instances == 0)
+            return;
+        if(meshes.empty() && proxy)
+            proxy->DrawInstanced(shader, instances);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instances, lod);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // applies policy to every mesh uploaded so far and to the ones still loading.
+    // a ModelBatch copies the vertices in add() and append(), so a batched model can drop them once it is complete.
+    void setResidency(MeshResidency policy)
     {
+        residency = std::max(residency, policy);
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].setResidency(residency);
+    }
+
+    // video memory held by the vertex and index buffers of all meshes
+    size_t gpuBytes() const
+    {
+        size_t bytes = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            bytes += meshes[i].gpuBytes();
+        return bytes;
+    }
+
+    // system memory held by the geometry of all meshes
+    size_t cpuBytes() const
+    {
+        size_t bytes = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            bytes += meshes[i].cpuBytes();
+        return bytes;
     }
     
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    shared_ptr<ModelImport> import;     // shared with the worker, null once the model is complete
+    std::future<void> worker;
+    unique_ptr<Mesh> proxy;             // bounding box drawn while no mesh is resident
+    unsigned int instanceTransforms, instanceTints;
+    unsigned int instances;
+
+    // a copy would release the shared textures twice
+    Model(const Model&);
+    Model &operator=(const Model&);
+
+    // loads a model with supported ASSIMP extensions from file and hands the resulting meshes to import one by one.
+    // runs on the worker thread of an asynchronous model, so it only touches import and the file system.
+    static void importModel(string path, shared_ptr<ModelImport> import)
     {
+        vector<MeshData> data;
+        // a valid cache skips ASSIMP entirely
+        if(loadCache(path, data))
+        {
+            for(unsigned int i = 0; i < data.size(); i++)
+                publishBounds(*import, data[i].vertices);
+            for(unsigned int i = 0; i < data.size(); i++)
+                publish(*import, std::move(data[i]));
+            finish(*import);
+            return;
+        }
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            finish(*import);
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+
+        // the raw positions already give the bounds the proxy needs, long before the meshes are optimized
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            const aiMesh *mesh = scene->mMeshes[i];
+            vector<glm::vec3> positions(mesh->mNumVertices);
+            for(unsigned int v = 0; v < mesh->mNumVertices; v++)
+                positions[v] = glm::vec3(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+            publishBounds(*import, positions);
+        }
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, *import, data);
+        if(!import->cancelled)
+        {
+            printStats(path, data);
+            saveCache(path, data);
+        }
+        finish(*import);
+    }
+
+    template <typename T>
+    static void publishBounds(ModelImport &import, const vector<T> &points)
+    {
+        std::lock_guard<std::mutex> lock(import.mutex);
+        for(unsigned int i = 0; i < points.size(); i++)
+        {
+            const glm::vec3 &p = position(points[i]);
+            import.lower = import.boundsKnown ? glm::min(import.lower, p) : p;
+            import.upper = import.boundsKnown ? glm::max(import.upper, p) : p;
+            import.boundsKnown = true;
+        }
+    }
+
+    static const glm::vec3 &position(const glm::vec3 &point)
+    {
+        return point;
+    }
+
+    static const glm::vec3 &position(const Vertex &vertex)
+    {
+        return vertex.Position;
+    }
+
+    static void publish(ModelImport &import, MeshData mesh)
+    {
+        std::lock_guard<std::mutex> lock(import.mutex);
+        import.ready.push_back(std::move(mesh));
+    }
+
+    static void finish(ModelImport &import)
+    {
+        std::lock_guard<std::mutex> lock(import.mutex);
+        import.done = true;
+    }
+
+    // uploads one imported mesh and takes the references on its textures, with loadTextures set. the mesh takes over the arrays of data.
+    void addMesh(MeshData &data)
+    {
+        vector<Texture> textures;
+        bool diffuse = false;
+        for(unsigned int i = 0; i < data.textures.size(); i++)
+        {
+            textures.push_back(loadTextures ? loadTexture(data.textures[i].path.c_str(), data.textures[i].type) : data.textures[i]);
+            diffuse = diffuse || data.textures[i].type == "texture_diffuse";
+        }
+        // without a diffuse map texture_diffuse1 would sample whatever another map left on its unit
+        if(loadTextures && !diffuse)
+        {
+            Texture white = textureReference("", "texture_diffuse");
+            white.id = TextureManager::get().acquireWhite();
+            textures_loaded.push_back(white);
+            textures.push_back(white);
+        }
+        meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), vertexFormat,
+                              std::move(data.lodIndexCounts), residency));
+        if(instanceTransforms)
+            meshes.back().setInstanceBuffers(instanceTransforms, instanceTints);
+    }
+
+    // the 24 vertices of a box, four per face so every face has its own normal
+    static vector<Vertex> boxVertices(const glm::vec3 &lower, const glm::vec3 &upper)
+    {
+        vector<Vertex> vertices;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            for(int side = 0; side < 2; side++)
+            {
+                glm::vec3 normal(0.0f);
+                normal[axis] = side ? 1.0f : -1.0f;
+                int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                for(int corner = 0; corner < 4; corner++)
+                {
+                    // counter clockwise seen from outside the box
+                    int cu = corner == 1 || corner == 2, cv = corner >= 2;
+                    if(!side)
+                        cu = 1 - cu;
+                    Vertex vertex;
+                    vertex.Position[axis] = side ? upper[axis] : lower[axis];
+                    vertex.Position[u] = cu ? upper[u] : lower[u];
+                    vertex.Position[v] = cv ? upper[v] : lower[v];
+                    vertex.Normal = normal;
+                    vertex.TexCoords = glm::vec2(cu, cv);
+                    vertex.Tangent = glm::vec3(0.0f);
+                    vertex.Tangent[u] = 1.0f;
+                    vertex.Bitangent = glm::cross(normal, vertex.Tangent);
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+        return vertices;
+    }
+
+    static vector<unsigned int> boxIndices()
+    {
+        vector<unsigned int> indices;
+        for(unsigned int face = 0; face < 6; face++)
+        {
+            const unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+            for(int i = 0; i < 6; i++)
+                indices.push_back(face * 4 + quad[i]);
+        }
+        return indices;
+    }
+
+    // waits for the texture decodes queued while processing the meshes and uploads them.
+    // all of them were queued before the first wait, so they decode in parallel.
+    void uploadTextures()
+    {
+        TextureManager::get().uploadPending();
+    }
+
+    static string cachePath(string const &path)
+    {
+        return path + ".meshcache";
+    }
+
+    static size_t alignCache(size_t offset)
+    {
+        return (offset + 7) & ~size_t(7);
+    }
+
+    // fills the header fields that have to match for a cache to be used
+    static bool cacheKey(string const &path, ModelCacheHeader &header)
+    {
+        struct stat info;
+        if(stat(path.c_str(), &info) != 0)
+            return false;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "LOGLMDL", 8);
+        header.version = MODEL_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = MODEL_IMPORT_FLAGS;
+        header.sourceTime = (long long)info.st_mtime;
+        header.sourceSize = (unsigned long long)info.st_size;
+        header.pathLength = path.size();
+        return true;
+    }
+
+    // loads the meshes from <path>.meshcache if it was written for this exact source file and import setup.
+    // the file is mapped, so the arrays are copied into the meshes straight from the page cache
+    static bool loadCache(string const &path, vector<MeshData> &meshes)
+    {
+        ModelCacheHeader key;
+        if(!cacheKey(path, key))
+            return false;
+
+        MappedFile file(cachePath(path));
+        const size_t size = file.size();
+        if(size < sizeof(ModelCacheHeader))
+            return false;
+
+        const char *base = file.data();
+        ModelCacheHeader header;
+        memcpy(&header, base, sizeof(header));
+        key.meshCount = header.meshCount;
+        size_t offset = sizeof(header);
+        if(memcmp(&header, &key, sizeof(header)) != 0 || offset + header.pathLength > size || path.compare(0, string::npos, base + offset, header.pathLength) != 0)
+            return false;
+        offset = alignCache(offset + header.pathLength);
+        if(offset + header.meshCount * sizeof(ModelCacheMesh) > size)
+            return false;
+
+        const ModelCacheMesh *records = (const ModelCacheMesh*)(base + offset);
+        vector<MeshData> cached(header.meshCount);
+        for(unsigned int i = 0; i < header.meshCount; i++)
+        {
+            const ModelCacheMesh &record = records[i];
+            if(record.vertexOffset + record.vertexCount * sizeof(Vertex) > size ||
+               record.indexOffset + record.indexCount * sizeof(unsigned int) > size ||
+               record.textureOffset > size || record.lodCount == 0 || record.lodCount > MESH_MAX_LODS)
+                return false;
+            // the levels follow each other in the index array, Mesh splits it by their counts
+            unsigned long long lodIndices = 0;
+            for(unsigned int l = 0; l < record.lodCount; l++)
+                lodIndices += record.lodIndexCounts[l];
+            if(lodIndices != record.indexCount)
+                return false;
+
+            const Vertex *vertices = (const Vertex*)(base + record.vertexOffset);
+            const unsigned int *indices = (const unsigned int*)(base + record.indexOffset);
+            MeshData &mesh = cached[i];
+            size_t cursor = record.textureOffset;
+            for(unsigned int t = 0; t < record.textureCount; t++)
+            {
+                string fields[2];
+                for(int f = 0; f < 2; f++)
+                {
+                    unsigned int length;
+                    if(cursor + sizeof(length) > size)
+                        return false;
+                    memcpy(&length, base + cursor, sizeof(length));
+                    cursor += sizeof(length);
+                    if(cursor + length > size)
+                        return false;
+                    fields[f].assign(base + cursor, length);
+                    cursor += length;
+                }
+                mesh.textures.push_back(textureReference(fields[1].c_str(), fields[0]));
+            }
+            mesh.vertices.assign(vertices, vertices + record.vertexCount);
+            mesh.indices.assign(indices, indices + record.indexCount);
+            mesh.lodIndexCounts.assign(record.lodIndexCounts, record.lodIndexCounts + record.lodCount);
+        }
+        meshes.swap(cached);
+        return true;
+    }
+
+    // writes the processed meshes to <path>.meshcache, through a temporary file so a crash never leaves a torn cache.
+    static void saveCache(string const &path, const vector<MeshData> &meshes)
+    {
+        ModelCacheHeader header;
+        if(!cacheKey(path, header))
+            return;
+        header.meshCount = meshes.size();
+
+        // lay out the file first, then fill it in one buffer
+        vector<ModelCacheMesh> records(meshes.size());
+        size_t offset = alignCache(alignCache(sizeof(header) + path.size()) + meshes.size() * sizeof(ModelCacheMesh));
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            ModelCacheMesh &record = records[i];
+            memset(&record, 0, sizeof(record));
+            record.vertexCount = mesh.vertices.size();
+            record.indexCount = mesh.indices.size();
+            record.textureCount = mesh.textures.size();
+            record.lodCount = mesh.lodIndexCounts.size();
+            for(unsigned int l = 0; l < mesh.lodIndexCounts.size() && l < MESH_MAX_LODS; l++)
+                record.lodIndexCounts[l] = mesh.lodIndexCounts[l];
+            record.vertexOffset = offset;
+            offset = alignCache(offset + mesh.vertices.size() * sizeof(Vertex));
+            record.indexOffset = offset;
+            offset = alignCache(offset + mesh.indices.size() * sizeof(unsigned int));
+            record.textureOffset = offset;
+            for(unsigned int t = 0; t < mesh.textures.size(); t++)
+                offset += 2 * sizeof(unsigned int) + mesh.textures[t].type.size() + mesh.textures[t].path.size();
+            offset = alignCache(offset);
+        }
+
+        vector<char> data(offset, 0);
+        memcpy(&data[0], &header, sizeof(header));
+        memcpy(&data[sizeof(header)], path.data(), path.size());
+        if(!records.empty())
+            memcpy(&data[alignCache(sizeof(header) + path.size())], &records[0], records.size() * sizeof(ModelCacheMesh));
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            if(!mesh.vertices.empty())
+                memcpy(&data[records[i].vertexOffset], &mesh.vertices[0], mesh.vertices.size() * sizeof(Vertex));
+            if(!mesh.indices.empty())
+                memcpy(&data[records[i].indexOffset], &mesh.indices[0], mesh.indices.size() * sizeof(unsigned int));
+            size_t cursor = records[i].textureOffset;
+            for(unsigned int t = 0; t < mesh.textures.size(); t++)
+            {
+                const string *fields[2] = { &mesh.textures[t].type, &mesh.textures[t].path };
+                for(int f = 0; f < 2; f++)
+                {
+                    unsigned int length = fields[f]->size();
+                    memcpy(&data[cursor], &length, sizeof(length));
+                    cursor += sizeof(length);
+                    memcpy(&data[cursor], fields[f]->data(), length);
+                    cursor += length;
+                }
+            }
+        }
+
+        string temporary = cachePath(path) + ".tmp";
+        ofstream file(temporary.c_str(), ios::binary | ios::trunc);
+        if(!file.write(&data[0], data.size()))
+            return;
+        file.close();
+        remove(cachePath(path).c_str());
+        if(rename(temporary.c_str(), cachePath(path).c_str()) != 0)
+            cout << "ERROR::MODEL_CACHE:: could not write " << cachePath(path) << endl;
+    }
+
+    // one line for the whole model: vertices before and after welding, ACMR weighted by triangles, and the
+    // triangles of every level of detail summed over the meshes
+    static void printStats(string const &path, const vector<MeshData> &meshes)
+    {
+        unsigned long long before = 0, after = 0, triangles = 0;
+        double missesBefore = 0.0, missesAfter = 0.0;
+        vector<unsigned long long> lodTriangles;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            unsigned int count = mesh.lodIndexCounts.empty() ? mesh.indices.size() / 3 : mesh.lodIndexCounts[0] / 3;
+            before += mesh.stats.verticesBefore;
+            after += mesh.stats.verticesAfter;
+            triangles += count;
+            missesBefore += (double)mesh.stats.acmrBefore * count;
+            missesAfter += (double)mesh.stats.acmrAfter * count;
+            if(lodTriangles.size() < mesh.lodIndexCounts.size())
+                lodTriangles.resize(mesh.lodIndexCounts.size(), 0);
+            for(unsigned int l = 0; l < mesh.lodIndexCounts.size(); l++)
+                lodTriangles[l] += mesh.lodIndexCounts[l] / 3;
+        }
+        double scale = triangles > 0 ? 1.0 / triangles : 0.0;
+        cout << "model " << path.substr(path.find_last_of('/') + 1) << ": " << meshes.size() << " meshes, " << before << " -> " << after
+             << " vertices, ACMR " << missesBefore * scale << " -> " << missesAfter * scale << ", LOD triangles";
+        for(unsigned int l = 0; l < lodTriangles.size(); l++)
+            cout << " " << lodTriangles[l];
+        cout << endl;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // every finished mesh goes to import right away, so the model can upload it while the rest is still being processed.
+    static void processNode(aiNode *node, const aiScene *scene, ModelImport &import, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        for(unsigned int i = 0; i < node->mNumMeshes && !import.cancelled; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
             meshes.push_back(processMesh(mesh, scene));
+            // the import keeps its own copy for the cache file, written once every mesh is done
+            publish(import, meshes.back());
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, import, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
-
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
@@ -142,6 +729,20 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);        
         }
+        // weld, reorder for the vertex cache and overdraw, then for vertex fetch. the cache stores the result.
+        MeshOptimizerStats &stats = data.stats;
+        stats = optimizeMesh(vertices, indices);
+        // simplified levels of detail go after the full index list, over the same vertices
+        vector<unsigned int> &lodIndexCounts = data.lodIndexCounts;
+        buildMeshLods(vertices, indices, lodIndexCounts);
+        if(modelPrintMeshStats)
+        {
+            cout << "mesh " << mesh->mName.C_Str() << ": " << stats.verticesBefore << " -> " << stats.verticesAfter << " vertices, ACMR "
+                 << stats.acmrBefore << " -> " << stats.acmrAfter << ", LOD triangles";
+            for(unsigned int i = 0; i < lodIndexCounts.size(); i++)
+                cout << " " << lodIndexCounts[i] / 3;
+            cout << endl;
+        }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -164,81 +765,52 @@ private:
         std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // the mesh object is created from the extracted data on the GL thread
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and returns references to them.
+    // the textures themselves are acquired when the mesh is uploaded.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(textureReference(str.C_Str(), typeName));
         }
         return textures;
     }
-};
 
+    static Texture textureReference(const char *path, string const &typeName)
+    {
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
+    }
+
+    // takes a reference on a texture used by the model. the TextureManager only loads files it doesn't hold yet,
+    // new ones are decoded in the background and uploaded in uploadTextures() or, while loading asynchronously, update().
+    Texture loadTexture(const char *path, string const &typeName)
+    {
+        Texture texture = textureReference(path, typeName);
+        texture.id = TextureManager::get().acquire(this->directory + '/' + string(path));
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+};
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    // the caller owns one reference and gives it back with TextureManager::get().release()
+    unsigned int textureID = TextureManager::get().acquire(filename);
+    TextureManager::get().uploadPending();
 
     return textureID;
 }
@@ -0,0 +1,1213 @@
+#ifndef MODEL_BATCH_H
+#define MODEL_BATCH_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/hiz_buffer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_loader.h>
+#include <learnopengl/texture_manager.h>
+#include <learnopengl/vertex_packing.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// one record of the GL_DRAW_INDIRECT_BUFFER, layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int          baseVertex;
+    unsigned int baseInstance;
+};
+
+// per draw data, fetched as an instanced vertex attribute (divisor 1).
+// every command draws one instance starting at baseInstance = its own index, so attribute
+// fetch picks the right record without needing gl_DrawID (GL 4.6 / ARB_shader_draw_parameters).
+struct DrawData
+{
+    glm::mat4 model;       // locations 5 ~ 8
+    unsigned int material; // location 9, layer of the diffuse texture array
+    float fade;            // location 10, dithered cross-fade: 1 = opaque, f > 0 covers a share f, -f covers the rest
+    unsigned int padding[2];
+};
+
+// box of one draw record in the space of its model matrix, read by cull.cs (std430, binding 2)
+struct DrawBounds
+{
+    glm::vec4 lower;
+    glm::vec4 upper;
+};
+
+// draws the meshes of any number of models with a single glMultiDrawElementsIndirect.
+// all vertices and indices live in one shared VBO/EBO, every mesh becomes one indirect command,
+// and the diffuse textures become layers of a few GL_TEXTURE_2D_ARRAYs, one per size and format, so nothing
+// has to be rebound between meshes. shaders read the material (array and layer) from attribute 9 and the model
+// matrix from attributes 5 ~ 8, see man_batch.vs.
+// below GL 4.3 the same commands are issued one by one with glDrawElementsBaseVertex.
+// DrawInstanced() draws copies of one model from the same buffers and texture arrays, e.g. for a crowd.
+// the vertices are uploaded in the batch's own VertexFormat, indices are 16 bit when every mesh has at most 65536 vertices.
+// a model loading in the background is appended mesh by mesh as its meshes arrive, the shared buffers grow as needed.
+// once finish() says nothing more comes, uploadMaterials() fills the texture arrays over the next frames.
+// every model is drawn at one level of detail, picked by selectLod() from its size on screen. with crossFade set,
+// a switch draws both levels for LOD_FADE_SECONDS under complementary dither masks instead of popping.
+// with faceNormals set, append() also stores a copy in which every triangle has its own three vertices carrying the
+// triangle's normal, for shaders that move whole faces (man_batch.vs) without a geometry shader to find the normal
+// per primitive. drawFaceNormals() picks the copy Draw() renders, the indexed one stays for everything else.
+// on GL 4.3 cullOnGpu() can frustum test every draw record in a compute shader right before Draw(), which then
+// consumes the compacted survivors. the cpu then only touches the records of models that moved or faded, and
+// rebuilds all of them when a level of detail switch or setMeshVisible() changes their number.
+// given the HiZBuffer of the last frame it also drops draws hidden behind what was drawn there. those are tested
+// again by retestOnGpu() against the pyramid of the current frame and drawn by a second Draw() if they came into view.
+// without cullOnGpu() (below GL 4.3, or with it switched off) queryOcclusion() draws the box of every mesh into an
+// occlusion query instead, and Draw() then renders each mesh on its own, conditionally on its query.
+class ModelBatch
+{
+public:
+    // largest layer of the texture arrays, bigger textures lose their top mip levels
+    static const int MAX_LAYER_SIZE = 1024;
+    // texture arrays bound at once, man_batch.fs has as many samplers. the materials that fit in none are drawn white
+    static const unsigned int MAX_MATERIAL_ARRAYS = 4;
+    // attribute 9 of a mesh without a diffuse texture, otherwise it holds array << 16 | layer
+    static const unsigned int MATERIAL_UNTEXTURED = 0xFFFFFFFFu;
+    // bounding sphere radius on screen down to which a model keeps full detail
+    static constexpr float LOD_FULL_DETAIL_PIXELS = 200.0f;
+    static constexpr float LOD_FADE_SECONDS = 0.5f;
+
+    bool crossFade;
+    // read by append(): stores a face normal copy of every mesh next to the indexed one, at the cost of one vertex per index
+    bool faceNormals;
+
+    ModelBatch(VertexFormat format = VERTEX_FLOAT)
+        : crossFade(true), faceNormals(false), VAO(0), VBO(0), EBO(0), drawBuffer(0), commandBuffer(0), boundsBuffer(0), culledBuffer(0), counterBuffer(0),
+          retestBuffer(0), boxVAO(0), boxVBO(0), boxEBO(0), instanceVAO(0), instanceBuffer(0), instances(0), built(false), dirty(false), finished(false), planned(false),
+          texturesResident(false), uploadedMaterials(0), faceNormalsDrawn(false), gpuCulled(false), queried(false), occlusionTested(false), cullMargin(0.0f),
+          format(format), indexType(GL_UNSIGNED_SHORT), vertexCount(0), vertexBytes(0), indexBytes(0), vertexCapacity(0),
+          indexCapacity(0), bytes(0), textureBytes(0) {}
+
+    ~ModelBatch()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &drawBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &boundsBuffer);
+        glDeleteBuffers(1, &culledBuffer);
+        glDeleteBuffers(1, &counterBuffer);
+        glDeleteBuffers(1, &retestBuffer);
+        glDeleteVertexArrays(1, &boxVAO);
+        glDeleteBuffers(1, &boxVBO);
+        glDeleteBuffers(1, &boxEBO);
+        glDeleteVertexArrays(1, &instanceVAO);
+        glDeleteBuffers(1, &instanceBuffer);
+        if(!queries.empty())
+            glDeleteQueries(queries.size(), &queries[0]);
+        for(unsigned int i = 0; i < arrays.size(); i++)
+            glDeleteTextures(1, &arrays[i].texture);
+    }
+
+    // registers model and appends the meshes it has so far, returns the handle used by setTransform() and selectLod().
+    // the batch uploads its own copy in its own format, the meshes' buffers are left alone for models that are
+    // still drawn by themselves as well. a model that is only ever drawn through the batch can be deleted once complete.
+    unsigned int add(const Model &model)
+    {
+        if(!built)
+            createBuffers();
+        BatchModel entry;
+        entry.transform = glm::mat4(1.0f);
+        entry.lod = entry.previousLod = 0;
+        entry.fade = 1.0f;
+        entry.lodCount = MESH_MAX_LODS;
+        entry.firstRecord = entry.recordCount = 0;
+        entry.moved = false;
+        entry.center = glm::vec3(0.0f);
+        entry.radius = 0.0f;
+        models.push_back(entry);
+        append(models.size() - 1, model);
+        return models.size() - 1;
+    }
+
+    // appends the meshes model uploaded since the last call, meant to be called every frame while it loads: a mesh
+    // is packed and copied to the end of the shared buffers in the frame it arrives in, and Draw() shows what is there.
+    // the meshes have to keep their vertices until then (MESH_KEEP_ALL), and every model is complete before finish().
+    void append(unsigned int handle, const Model &model)
+    {
+        BatchModel &entry = models[handle];
+        if(entry.meshes.size() >= model.meshes.size())
+            return;
+        if(finished)
+        {
+            std::cout << "ERROR::MODEL_BATCH:: meshes appended after finish()" << std::endl;
+            return;
+        }
+
+        // every mesh is packed on its own, so quantized positions use the bounds of their mesh
+        vector<unsigned char> packed;
+        unsigned int firstNew = indices.size(), largest = 0;
+        for(unsigned int i = entry.meshes.size(); i < model.meshes.size(); i++)
+        {
+            const Mesh &mesh = model.meshes[i];
+            if(mesh.vertices.empty() && !mesh.lods.empty() && mesh.lods[0].indexCount > 0)
+                std::cout << "ERROR::MODEL_BATCH:: mesh " << i << " no longer has its vertices, append it before changing its residency" << std::endl;
+            BatchMesh batched;
+            batched.material = material(model, mesh);
+            batched.bounds = mesh.bounds;
+            batched.visible = true;
+            batched.indexed = store(mesh, mesh.vertices, mesh.indices, packed);
+            batched.hasFaces = faceNormals;
+            if(faceNormals)
+            {
+                vector<Vertex> meshVertices(mesh.vertices);
+                vector<unsigned int> meshIndices(mesh.indices);
+                splitFaces(meshVertices, meshIndices);
+                batched.faces = store(mesh, meshVertices, meshIndices, packed);
+            }
+            largest = std::max(largest, std::max(batched.indexed.vertexCount, batched.faces.vertexCount));
+
+            entry.lodCount = std::min(entry.lodCount, (int)std::max<size_t>(batched.indexed.lods.size(), 1));
+            entry.bounds.add(mesh.bounds);
+            entry.meshes.push_back(meshes.size());
+            meshes.push_back(batched);
+        }
+        if(!entry.bounds.empty())
+        {
+            entry.center = entry.bounds.center();
+            entry.radius = glm::length(entry.bounds.extent());
+        }
+        entry.lod = std::min(entry.lod, entry.lodCount - 1);
+        entry.previousLod = std::min(entry.previousLod, entry.lodCount - 1);
+
+        glBindVertexArray(VAO);
+        if(ensureCapacity(VBO, vertexCapacity, vertexBytes, vertexBytes + packed.size()))
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            setupVertexAttributes(format);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if(!packed.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBytes, packed.size(), &packed[0]);
+        vertexBytes += packed.size();
+
+        // indices are relative to baseVertex, so only the largest mesh decides their width. a mesh too large for
+        // 16 bits repacks all of them, which is what the cpu copy is kept around for until finish()
+        packed.clear();
+        if(indexType == GL_UNSIGNED_SHORT && largest > 65536)
+        {
+            indexType = packIndices(indices, false, packed);
+            indexBytes = 0;
+        }
+        else
+            packIndices(vector<unsigned int>(indices.begin() + firstNew, indices.end()), indexType == GL_UNSIGNED_SHORT, packed);
+        if(ensureCapacity(EBO, indexCapacity, indexBytes, indexBytes + packed.size()))
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if(!packed.empty())
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, packed.size(), &packed[0]);
+        indexBytes += packed.size();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        bytes = vertexCapacity + indexCapacity;
+        dirty = true;
+    }
+
+    // every model is complete: the buffers shrink to what they hold, the cpu copy of the indices is dropped and
+    // uploadMaterials() starts on the texture arrays
+    void finish()
+    {
+        if(!built || finished)
+            return;
+        glBindVertexArray(VAO);
+        if(ensureCapacity(VBO, vertexCapacity, vertexBytes, vertexBytes, true))
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            setupVertexAttributes(format);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        if(ensureCapacity(EBO, indexCapacity, indexBytes, indexBytes, true))
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindVertexArray(0);
+        bytes = vertexCapacity + indexCapacity;
+        vector<unsigned int>().swap(indices);
+        finished = true;
+    }
+
+    // fills the texture arrays a few layers at a time, call it every frame after finish(). nothing is uploaded
+    // until the loader has prepared every layer, then each call copies at most budget bytes of them (at least one
+    // layer). the meshes are drawn white until the last layer is in and then switch to their textures together.
+    // returns true once they have.
+    bool uploadMaterials(size_t budget = MODEL_UPLOAD_BUDGET)
+    {
+        if(texturesResident)
+            return true;
+        if(!finished)
+            return false;
+        if(!planned)
+        {
+            for(unsigned int i = 0; i < materials.size(); i++)
+                if(materials[i].image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    return false;
+            planTextureArrays();
+            planned = true;
+        }
+
+        size_t spent = 0;
+        while(uploadedMaterials < materials.size() && (spent == 0 || spent < budget))
+        {
+            Material &material = materials[uploadedMaterials++];
+            if(material.code == MATERIAL_UNTEXTURED)
+                continue;
+            const MaterialArray &array = arrays[material.code >> 16];
+            GLint layer = material.code & 0xFFFF;
+            const Image &image = material.image.get();
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+            for(int l = 0; l < array.levels; l++)
+            {
+                const ImageLevel &level = image.levels[l];
+                const unsigned char *pixels = image.data.get() + level.offset;
+                if(array.format == GL_RGBA8)
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                else
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, level.width, level.height, 1, array.format, level.size, pixels);
+                spent += level.size;
+            }
+            material.image = std::shared_future<Image>();
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        if(uploadedMaterials < materials.size())
+            return false;
+        texturesResident = true;
+        dirty = true;
+        return true;
+    }
+
+    // true once uploadMaterials() has put every texture in place
+    bool materialsResident() const
+    {
+        return texturesResident;
+    }
+
+    // switches Draw() between the face normal copies (for man_batch.vs with EXPLODE) and the indexed ones, which
+    // are smaller and make better use of the vertex cache. meshes appended without faceNormals stay indexed
+    void drawFaceNormals(bool faces)
+    {
+        if(faces == faceNormalsDrawn)
+            return;
+        faceNormalsDrawn = faces;
+        dirty = true;
+    }
+
+    // model matrix of every mesh added with the given handle, uploaded by the next Draw().
+    // only the records of the model are rewritten, the rest of the batch stays on the gpu as it is
+    void setTransform(unsigned int handle, const glm::mat4 &model)
+    {
+        models[handle].transform = model;
+        markMoved(handle);
+    }
+
+    int meshCount(unsigned int handle) const
+    {
+        return models[handle].meshes.size();
+    }
+
+    // model space box of one mesh of a model, for culling
+    const AABB &meshBounds(unsigned int handle, unsigned int mesh) const
+    {
+        return meshes[models[handle].meshes[mesh]].bounds;
+    }
+
+    // model space box of all meshes of a model appended so far
+    const AABB &modelBounds(unsigned int handle) const
+    {
+        return models[handle].bounds;
+    }
+
+    // a culled mesh keeps its place in the batch but issues no draw
+    void setMeshVisible(unsigned int handle, unsigned int mesh, bool visible)
+    {
+        BatchMesh &batched = meshes[models[handle].meshes[mesh]];
+        if(batched.visible == visible)
+            return;
+        batched.visible = visible;
+        dirty = true;
+    }
+
+    // switches a model to another level of detail, cross-fading from the current one when crossFade is set
+    void setLod(unsigned int handle, int lod)
+    {
+        BatchModel &model = models[handle];
+        lod = std::min(std::max(lod, 0), model.lodCount - 1);
+        if(lod == model.lod)
+            return;
+        model.previousLod = model.lod;
+        model.lod = lod;
+        model.fade = crossFade ? 0.0f : 1.0f;
+        dirty = true;
+    }
+
+    // picks the level of detail from the projected size of the model's bounding sphere, with some hysteresis
+    // around the current level. fovy is in radians, screenHeight the height of the framebuffer in pixels. a model that is still fading keeps its level until the fade is over.
+    int selectLod(unsigned int handle, const glm::vec3 &eye, float fovy, float screenHeight)
+    {
+        BatchModel &model = models[handle];
+        if(model.fade < 1.0f)
+            return model.lod;
+        glm::vec3 center = glm::vec3(model.transform * glm::vec4(model.center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model.transform[0])),
+                               std::max(glm::length(glm::vec3(model.transform[1])), glm::length(glm::vec3(model.transform[2]))));
+        float distance = std::max(glm::length(center - eye), 1e-4f);
+        float pixels = model.radius * scale * screenHeight / (2.0f * tanf(fovy / 2.0f) * distance);
+        setLod(handle, lodForScreenSize(pixels, LOD_FULL_DETAIL_PIXELS, model.lodCount, model.lod));
+        return model.lod;
+    }
+
+    // advances the running cross-fades
+    void update(float deltaTime)
+    {
+        for(unsigned int i = 0; i < models.size(); i++)
+        {
+            if(models[i].fade >= 1.0f)
+                continue;
+            models[i].fade = std::min(1.0f, models[i].fade + deltaTime / LOD_FADE_SECONDS);
+            // a finished fade drops the record of the old level, until then only the fade values change
+            if(models[i].fade >= 1.0f)
+                dirty = true;
+            else
+                markMoved(i);
+        }
+    }
+
+    // frustum culls every draw record on the gpu with cullShader (cull.cs) and compacts the visible ones to the
+    // front of the buffer the next Draw() consumes. margin grows every box in world units, e.g. for vertex animation.
+    // with occluders, a HiZBuffer built from an earlier frame, draws behind its depth are held back for retestOnGpu().
+    // without GL_ARB_indirect_parameters the draw count stays on the gpu side, so the slots past the survivors
+    // are cleared to zero instances and cost the command processor a little but no vertex work.
+    void cullOnGpu(Shader &cullShader, const glm::mat4 &viewProjection, float margin = 0.0f, const HiZBuffer *occluders = NULL)
+    {
+        if(!built || !GLAD_GL_VERSION_4_3)
+            return;
+        if(stale())
+            flushDraws();
+        cullMargin = margin;
+        cullFrustum = Frustum(viewProjection);
+        occlusionTested = occluders && occluders->valid();
+        dispatchCull(cullShader, 0, occlusionTested ? occluders : NULL);
+    }
+
+    // second pass after the HiZBuffer was rebuilt from the current frame: the draws cullOnGpu() found occluded by
+    // the old depth are tested against the new one and the ones in view now are handed to the next Draw().
+    // the old pyramid shows where things were, so objects moving out from behind an occluder are caught here.
+    // returns false when there is nothing to draw, e.g. without an occlusion test in the first pass.
+    bool retestOnGpu(Shader &cullShader, const HiZBuffer &occluders)
+    {
+        if(!built || !GLAD_GL_VERSION_4_3 || stale() || !occlusionTested || !occluders.valid())
+            return false;
+        dispatchCull(cullShader, 1, &occluders);
+        return true;
+    }
+
+    // issues an occlusion query per visible mesh by drawing its world space box, grown by margin, with boxShader
+    // (occlusion_box.vs) and color and depth writes off. the next Draw() renders every mesh conditionally on its query,
+    // so the gpu skips hidden ones without a round trip to the cpu. meant for the path without GL 4.3: call it
+    // once the occluders are drawn, all queries go out before the first conditional draw so they have time to finish.
+    void queryOcclusion(Shader &boxShader, const glm::mat4 &viewProjection, const glm::vec3 &eye, float margin = 0.0f)
+    {
+        if(!built || meshes.empty())
+            return;
+        if(boxVAO == 0)
+            buildBox();
+        if(queries.size() < meshes.size())
+        {
+            queries.resize(meshes.size(), 0);
+            glGenQueries(queries.size(), &queries[0]);
+        }
+        queriedMeshes.assign(meshes.size(), false);
+
+        boxShader.use();
+        boxShader.setMat4("viewProjection", viewProjection);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(boxVAO);
+        for(unsigned int m = 0; m < models.size(); m++)
+        {
+            for(unsigned int k = 0; k < models[m].meshes.size(); k++)
+            {
+                unsigned int i = models[m].meshes[k];
+                if(!meshes[i].visible || meshes[i].indexed.lods.empty())
+                    continue;
+                AABB box = meshes[i].bounds.transformed(models[m].transform).expanded(margin);
+                // the box would be clipped by the near plane with the eye inside, such meshes are always drawn
+                if(box.expanded(0.1f).contains(AABB(eye, eye)))
+                    continue;
+                boxShader.setVec3("lower", box.lower);
+                boxShader.setVec3("upper", box.upper);
+                glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[i]);
+                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+                glEndQuery(GL_ANY_SAMPLES_PASSED);
+                queriedMeshes[i] = true;
+            }
+        }
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        queried = true;
+    }
+
+    // draw records that survived the last cullOnGpu(). reads the counter back, which waits for the gpu: debugging only
+    unsigned int gpuVisibleCount() const
+    {
+        unsigned int count = 0;
+        if(!gpuCulled)
+            return commands.size();
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return count;
+    }
+
+    void Draw(Shader &shader)
+    {
+        if(!built || meshes.empty())
+            return;
+        glBindVertexArray(VAO);
+        // records changed since cullOnGpu() make its output stale, so the full list is drawn then
+        if(stale())
+        {
+            flushDraws();
+            gpuCulled = false;
+            queried = false;
+        }
+
+        bindMaterials(shader);
+
+        // a multi draw can not be made conditional per command, so meshes with an occlusion query go one by one
+        if(GLAD_GL_VERSION_4_3 && !queried)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulled ? culledBuffer : commandBuffer);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)0, commands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            gpuCulled = false;
+        }
+        else
+        {
+            // without base instance the per draw attributes are fed as constants instead
+            for(unsigned int i = 5; i <= 10; i++)
+                glDisableVertexAttribArray(i);
+            for(unsigned int i = 0; i < commands.size(); i++)
+            {
+                const glm::mat4 &model = draws[i].model;
+                for(unsigned int c = 0; c < 4; c++)
+                    glVertexAttrib4fv(5 + c, &model[c][0]);
+                glVertexAttribI1ui(9, draws[i].material);
+                glVertexAttrib1f(10, draws[i].fade);
+                bool conditional = queried && queriedMeshes[recordMeshes[i]];
+                if(conditional)
+                    glBeginConditionalRender(queries[recordMeshes[i]], GL_QUERY_WAIT);
+                glDrawElementsBaseVertex(GL_TRIANGLES, commands[i].count, indexType,
+                                         (void*)(commands[i].firstIndex * indexSize(indexType)), commands[i].baseVertex);
+                if(conditional)
+                    glEndConditionalRender();
+            }
+            queried = false;
+            gpuCulled = false;
+            for(unsigned int i = 5; i <= 10; i++)
+                glEnableVertexAttribArray(i);
+        }
+        glBindVertexArray(0);
+    }
+
+    // uploads the model matrices DrawInstanced() renders, one copy of a model per matrix. can be called again to move
+    // them. the copies have a vertex array of their own over the final buffers, so they wait for finish()
+    void setInstances(const vector<glm::mat4> &transforms)
+    {
+        if(!finished)
+            return;
+        if(!instanceVAO)
+        {
+            glGenVertexArrays(1, &instanceVAO);
+            glGenBuffers(1, &instanceBuffer);
+            glBindVertexArray(instanceVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            setupVertexAttributes(format);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            for(unsigned int i = 0; i < 4; i++)
+            {
+                glEnableVertexAttribArray(5 + i);
+                glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(i * sizeof(glm::vec4)));
+                glVertexAttribDivisor(5 + i, 1);
+            }
+            glBindVertexArray(0);
+        }
+        instances = transforms.size();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.empty() ? NULL : &transforms[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // draws every mesh of the model handle once per matrix given to setInstances(), one glDrawElementsInstancedBaseVertex
+    // per mesh at level lod. the matrix of an instance comes in attributes 5 ~ 8 like the records of Draw(), the one
+    // that maps the stored positions back onto the mesh as the uniform positionTransform (man_batch.vs, INSTANCED)
+    void DrawInstanced(Shader &shader, unsigned int handle, int lod = 0)
+    {
+        if(!instanceVAO || instances == 0)
+            return;
+        bindMaterials(shader);
+        glBindVertexArray(instanceVAO);
+        glVertexAttrib1f(10, 1.0f);
+        const BatchModel &model = models[handle];
+        for(unsigned int k = 0; k < model.meshes.size(); k++)
+        {
+            const BatchMesh &mesh = meshes[model.meshes[k]];
+            const MeshCopy &copy = mesh.indexed;
+            if(copy.lods.empty())
+                continue;
+            const MeshLod &range = copy.lods[std::min(std::max(lod, 0), (int)copy.lods.size() - 1)];
+            shader.setMat4("positionTransform", copy.transform);
+            glVertexAttribI1ui(9, materialCode(mesh));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)(range.firstIndex * indexSize(indexType)),
+                                              instances, copy.baseVertex);
+        }
+        glBindVertexArray(0);
+    }
+
+    // draw records of the last Draw(), a fading mesh counts twice and one culled by setMeshVisible() not at all
+    unsigned int drawCount() const
+    {
+        return commands.size();
+    }
+
+    int lod(unsigned int handle) const
+    {
+        return models[handle].lod;
+    }
+
+    // triangles the last Draw() submitted
+    unsigned int triangleCount() const
+    {
+        unsigned int triangles = 0;
+        for(unsigned int i = 0; i < commands.size(); i++)
+            triangles += commands[i].count / 3;
+        return triangles;
+    }
+
+    // video memory held by the shared vertex and index buffers
+    size_t gpuBytes() const
+    {
+        return bytes;
+    }
+
+    // diffuse textures of the batch, each one layer of a texture array
+    unsigned int layerCount() const
+    {
+        unsigned int count = 0;
+        for(unsigned int i = 0; i < arrays.size(); i++)
+            count += arrays[i].layers.size();
+        return count;
+    }
+
+    unsigned int arrayCount() const
+    {
+        return arrays.size();
+    }
+
+    // video memory held by the texture arrays, mip levels included
+    size_t textureGpuBytes() const
+    {
+        return textureBytes;
+    }
+
+private:
+    // the geometry of a mesh as stored in the shared buffers
+    struct MeshCopy
+    {
+        unsigned int baseVertex;
+        unsigned int vertexCount;
+        unsigned int firstIndex;    // all levels of detail of the mesh, in the shared index buffer
+        unsigned int indexCount;
+        glm::mat4 transform;        // maps quantized positions back onto the mesh
+        vector<MeshLod> lods;       // index ranges in the shared index buffer
+        AABB drawBounds;            // bounds in the space transform maps from, i.e. of the stored positions
+
+        MeshCopy() : baseVertex(0), vertexCount(0), firstIndex(0), indexCount(0), transform(1.0f) {}
+    };
+
+    struct BatchMesh
+    {
+        MeshCopy indexed;
+        MeshCopy faces;             // de-indexed with face normals, stored when faceNormals was set
+        bool hasFaces;
+        unsigned int material;      // index into materials, MATERIAL_UNTEXTURED without a diffuse texture
+        AABB bounds;
+        bool visible;
+    };
+
+    struct BatchModel
+    {
+        vector<unsigned int> meshes;    // index of every mesh of the model in the batch's meshes, in the order they arrived
+        glm::mat4 transform;
+        AABB bounds;                // of the meshes appended so far, in model space
+        glm::vec3 center;           // bounding sphere of bounds
+        float radius;
+        int lodCount;               // levels every mesh of the model has
+        int lod, previousLod;
+        float fade;                 // progress of the switch from previousLod to lod, 1 when done
+        unsigned int firstRecord;   // records written for the model by the last writeDraws(), contiguous
+        unsigned int recordCount;
+        bool moved;                 // transform or fade changed since, queued in movedModels
+    };
+
+    // a diffuse texture, prepared on the texture loader and then uploaded into a layer of one of the arrays
+    struct Material
+    {
+        string file;
+        std::shared_future<Image> image;    // released once uploaded
+        unsigned int code;                  // array << 16 | layer, MATERIAL_UNTEXTURED without one
+    };
+
+    // layers of the same size, format and mip count
+    struct MaterialArray
+    {
+        unsigned int texture;
+        GLenum format;                      // block compressed format, GL_RGBA8 otherwise
+        int width, height, levels;
+        vector<unsigned int> layers;        // material of every layer
+    };
+
+    // threads per work group of cull.cs
+    static const unsigned int CULL_GROUP_SIZE = 64;
+
+    unsigned int VAO, VBO, EBO, drawBuffer, commandBuffer, boundsBuffer, culledBuffer, counterBuffer, retestBuffer;
+    unsigned int boxVAO, boxVBO, boxEBO;
+    unsigned int instanceVAO, instanceBuffer, instances;   // copies for DrawInstanced()
+    bool built, dirty;              // dirty: records were added or dropped, writeDraws() rebuilds them all
+    bool finished;                  // no more meshes, the cpu indices are gone
+    bool planned, texturesResident; // the texture arrays are allocated, and filled
+    unsigned int uploadedMaterials; // materials uploadMaterials() is done with
+    bool faceNormalsDrawn;          // Draw() renders the face normal copies, see drawFaceNormals()
+    bool gpuCulled;                 // culledBuffer holds this frame's commands
+    bool queried;                   // queries hold this frame's occlusion of the meshes flagged in queriedMeshes
+    bool occlusionTested;           // the last cullOnGpu() flagged occluded records for retestOnGpu()
+    float cullMargin;
+    Frustum cullFrustum;
+    vector<unsigned int> queries;   // occlusion query per mesh, created by the first queryOcclusion()
+    vector<bool> queriedMeshes;
+    VertexFormat format;
+    GLenum indexType;
+    unsigned int vertexCount;
+    size_t vertexBytes, indexBytes, vertexCapacity, indexCapacity;
+    size_t bytes, textureBytes;
+
+    vector<unsigned int> indices;   // every index so far, kept until finish() in case they have to be widened
+    vector<BatchMesh> meshes;
+    vector<BatchModel> models;
+    vector<DrawElementsIndirectCommand> commands;
+    vector<DrawData> draws;
+    vector<DrawBounds> bounds;
+    vector<unsigned int> recordMeshes;  // mesh of every record, selects its occlusion query
+    vector<unsigned int> movedModels;   // models whose records only need new matrices and fades
+    vector<Material> materials;
+    map<string, unsigned int> materialIndex;
+    vector<MaterialArray> arrays;
+
+    ModelBatch(const ModelBatch&);
+    ModelBatch &operator=(const ModelBatch&);
+
+    // de-indexes a mesh: vertex k becomes a copy of what index k pointed at, with the normal of the triangle k
+    // belongs to, and index k becomes k. the level of detail ranges stay where they are.
+    // a quantized mesh is stored as T^-1 * position with T scaling by the extent of its bounds, so its normals are
+    // stored as T^T * normal, which the model matrix (that includes T) turns back into the normal of the mesh.
+    void splitFaces(vector<Vertex> &meshVertices, vector<unsigned int> &meshIndices) const
+    {
+        vector<Vertex> split;
+        split.reserve(meshIndices.size());
+        for(unsigned int k = 0; k < meshIndices.size(); k++)
+            split.push_back(meshVertices[meshIndices[k]]);
+        meshVertices.swap(split);
+        for(unsigned int k = 0; k < meshIndices.size(); k++)
+            meshIndices[k] = k;
+        if(meshVertices.empty())
+            return;
+
+        glm::vec3 lower = meshVertices[0].Position, upper = meshVertices[0].Position;
+        for(unsigned int v = 0; v < meshVertices.size(); v++)
+        {
+            lower = glm::min(lower, meshVertices[v].Position);
+            upper = glm::max(upper, meshVertices[v].Position);
+        }
+        // same extent as packVertices() quantizes with
+        glm::vec3 extent = upper - lower;
+        for(int c = 0; c < 3; c++)
+            if(extent[c] <= 0.0f || format != VERTEX_PACKED_QUANTIZED)
+                extent[c] = 1.0f;
+
+        for(unsigned int v = 0; v + 2 < meshVertices.size(); v += 3)
+        {
+            glm::vec3 normal = glm::cross(meshVertices[v + 1].Position - meshVertices[v].Position, meshVertices[v + 2].Position - meshVertices[v].Position);
+            // a degenerate triangle keeps its zero normal, it has no area to show where it moves
+            if(glm::length(normal) > 0.0f)
+                normal = glm::normalize(glm::normalize(normal) * extent);
+            meshVertices[v].Normal = meshVertices[v + 1].Normal = meshVertices[v + 2].Normal = normal;
+        }
+    }
+
+    // the vertex array with the per draw attributes. the vertex and index buffers are created by the first append()
+    // that has something to put in them
+    void createBuffers()
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &drawBuffer);
+        glBindVertexArray(VAO);
+        // per draw records, one per instance. rewritten whenever a transform or level of detail changes
+        glBindBuffer(GL_ARRAY_BUFFER, drawBuffer);
+        for(unsigned int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(5 + i);
+            glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(DrawData), (void*)(offsetof(DrawData, model) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(5 + i, 1);
+        }
+        glEnableVertexAttribArray(9);
+        glVertexAttribIPointer(9, 1, GL_UNSIGNED_INT, sizeof(DrawData), (void*)offsetof(DrawData, material));
+        glVertexAttribDivisor(9, 1);
+        glEnableVertexAttribArray(10);
+        glVertexAttribPointer(10, 1, GL_FLOAT, GL_FALSE, sizeof(DrawData), (void*)offsetof(DrawData, fade));
+        glVertexAttribDivisor(10, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if(GLAD_GL_VERSION_4_3)
+        {
+            glGenBuffers(1, &commandBuffer);
+            glGenBuffers(1, &boundsBuffer);
+            glGenBuffers(1, &culledBuffer);
+            glGenBuffers(1, &counterBuffer);
+            glGenBuffers(1, &retestBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        built = true;
+    }
+
+    // makes buffer hold at least needed bytes, keeping its first used ones. it grows by doubling, so a model
+    // appended mesh by mesh copies every byte only a few times, and exact sizes it to needed, to give back what
+    // the doubling left over. returns true when buffer was replaced and has to be bound again where the old one was
+    static bool ensureCapacity(unsigned int &buffer, size_t &capacity, size_t used, size_t needed, bool exact = false)
+    {
+        if(exact ? needed == capacity : needed <= capacity)
+            return false;
+        size_t size = exact ? needed : std::max(needed, capacity * 2);
+        unsigned int resized;
+        glGenBuffers(1, &resized);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, resized);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+        if(used > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = resized;
+        capacity = size;
+        return true;
+    }
+
+    // packs one copy of mesh to the end of packed and of the cpu indices
+    MeshCopy store(const Mesh &mesh, const vector<Vertex> &meshVertices, const vector<unsigned int> &meshIndices, vector<unsigned char> &packed)
+    {
+        MeshCopy copy;
+        copy.baseVertex = vertexCount;
+        copy.vertexCount = meshVertices.size();
+        copy.firstIndex = indices.size();
+        copy.indexCount = meshIndices.size();
+        for(unsigned int l = 0; l < mesh.lods.size(); l++)
+        {
+            MeshLod lod = { (unsigned int)indices.size() + mesh.lods[l].firstIndex, mesh.lods[l].indexCount };
+            copy.lods.push_back(lod);
+        }
+        packVertices(meshVertices, format, packed, copy.transform);
+        copy.drawBounds = mesh.bounds.transformed(glm::inverse(copy.transform));
+        vertexCount += copy.vertexCount;
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        return copy;
+    }
+
+    // the copy Draw() renders of mesh
+    const MeshCopy &drawnCopy(const BatchMesh &mesh) const
+    {
+        return faceNormalsDrawn && mesh.hasFaces ? mesh.faces : mesh.indexed;
+    }
+
+    // what attribute 9 carries for mesh: white until every texture array is filled
+    unsigned int materialCode(const BatchMesh &mesh) const
+    {
+        return mesh.material == MATERIAL_UNTEXTURED || !texturesResident ? MATERIAL_UNTEXTURED : materials[mesh.material].code;
+    }
+
+    // the texture arrays on units 0 ~ MAX_MATERIAL_ARRAYS - 1, see man_batch.fs
+    void bindMaterials(Shader &shader)
+    {
+        for(unsigned int i = 0; i < MAX_MATERIAL_ARRAYS; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, i < arrays.size() ? arrays[i].texture : 0);
+            shader.setInt("materials[" + std::to_string(i) + "]", i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void addDraw(unsigned int meshIndex, const glm::mat4 &model, int lod, float fade)
+    {
+        const BatchMesh &mesh = meshes[meshIndex];
+        const MeshCopy &copy = drawnCopy(mesh);
+        const MeshLod &range = copy.lods[std::min(lod, (int)copy.lods.size() - 1)];
+        DrawElementsIndirectCommand command;
+        command.count = range.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = range.firstIndex;
+        command.baseVertex = copy.baseVertex;
+        command.baseInstance = commands.size();
+        commands.push_back(command);
+
+        DrawData data;
+        data.model = model * copy.transform;
+        data.material = materialCode(mesh);
+        data.fade = fade;
+        data.padding[0] = data.padding[1] = 0;
+        draws.push_back(data);
+
+        DrawBounds box = { glm::vec4(copy.drawBounds.lower, 1.0f), glm::vec4(copy.drawBounds.upper, 1.0f) };
+        bounds.push_back(box);
+        recordMeshes.push_back(meshIndex);
+    }
+
+    // one pass of cull.cs over every record, pass 0 being the frustum test and pass 1 the occlusion retest
+    void dispatchCull(Shader &cullShader, int pass, const HiZBuffer *occluders)
+    {
+        gpuCulled = true;
+        const unsigned int zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, culledBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        if(commands.empty())
+            return;
+
+        cullShader.use();
+        for(int i = 0; i < 6; i++)
+            cullShader.setVec4("planes[" + std::to_string(i) + "]", cullFrustum.planes[i]);
+        cullShader.setInt("drawCount", commands.size());
+        cullShader.setFloat("margin", cullMargin);
+        cullShader.setInt("pass", pass);
+        cullShader.setBool("occlusion", occluders != NULL);
+        if(occluders)
+        {
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, occluders->texture());
+            cullShader.setInt("depthPyramid", 0);
+            cullShader.setMat4("occluderViewProjection", occluders->viewProjection());
+            cullShader.setVec2("pyramidSize", glm::vec2(occluders->size()));
+            cullShader.setInt("pyramidLevels", occluders->levelCount());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, boundsBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, culledBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counterBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, retestBuffer);
+        glDispatchCompute((commands.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // unit cube for the occlusion queries, occlusion_box.vs stretches it from lower to upper
+    void buildBox()
+    {
+        static const float corners[] = { 0, 0, 0,  1, 0, 0,  0, 1, 0,  1, 1, 0,  0, 0, 1,  1, 0, 1,  0, 1, 1,  1, 1, 1 };
+        static const unsigned char faces[] = { 0, 2, 1,  1, 2, 3,  4, 5, 6,  5, 7, 6,  0, 1, 4,  1, 5, 4,
+                                               2, 6, 3,  3, 6, 7,  0, 4, 2,  2, 4, 6,  1, 3, 5,  3, 7, 5 };
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glGenBuffers(1, &boxEBO);
+        glBindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    // rebuilds the commands and their records: one per mesh, two while its model is cross-fading
+    void writeDraws()
+    {
+        commands.clear();
+        draws.clear();
+        bounds.clear();
+        recordMeshes.clear();
+        for(unsigned int m = 0; m < models.size(); m++)
+        {
+            BatchModel &model = models[m];
+            model.firstRecord = commands.size();
+            model.moved = false;
+            for(unsigned int k = 0; k < model.meshes.size(); k++)
+            {
+                unsigned int i = model.meshes[k];
+                if(meshes[i].indexed.lods.empty() || !meshes[i].visible)
+                    continue;
+                if(model.fade < 1.0f)
+                {
+                    addDraw(i, model.transform, model.lod, std::max(model.fade, 1e-3f));
+                    addDraw(i, model.transform, model.previousLod, -std::max(model.fade, 1e-3f));
+                }
+                else
+                    addDraw(i, model.transform, model.lod, 1.0f);
+            }
+            model.recordCount = commands.size() - model.firstRecord;
+        }
+        movedModels.clear();
+
+        glBindBuffer(GL_ARRAY_BUFFER, drawBuffer);
+        glBufferData(GL_ARRAY_BUFFER, draws.size() * sizeof(DrawData), draws.empty() ? NULL : &draws[0], GL_DYNAMIC_DRAW);
+        if(GLAD_GL_VERSION_4_3)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.empty() ? NULL : &commands[0], GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(DrawBounds), bounds.empty() ? NULL : &bounds[0], GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, culledBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, retestBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        dirty = false;
+    }
+
+    bool stale() const
+    {
+        return dirty || !movedModels.empty();
+    }
+
+    void markMoved(unsigned int handle)
+    {
+        if(models[handle].moved)
+            return;
+        models[handle].moved = true;
+        movedModels.push_back(handle);
+    }
+
+    // brings the draw records up to date: a full rebuild when their number changed, otherwise only the
+    // records of moved models are rewritten in place, so a moving model costs its own records and not the batch's
+    void flushDraws()
+    {
+        if(dirty)
+        {
+            writeDraws();
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, drawBuffer);
+        for(unsigned int k = 0; k < movedModels.size(); k++)
+        {
+            BatchModel &model = models[movedModels[k]];
+            model.moved = false;
+            float fade = model.fade < 1.0f ? std::max(model.fade, 1e-3f) : 1.0f;
+            for(unsigned int r = model.firstRecord; r < model.firstRecord + model.recordCount; r++)
+            {
+                draws[r].model = model.transform * drawnCopy(meshes[recordMeshes[r]]).transform;
+                draws[r].fade = draws[r].fade < 0.0f ? -fade : fade;
+            }
+            if(model.recordCount > 0)
+                glBufferSubData(GL_ARRAY_BUFFER, model.firstRecord * sizeof(DrawData), model.recordCount * sizeof(DrawData), &draws[model.firstRecord]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        movedModels.clear();
+    }
+
+    // material of the first diffuse texture of mesh. the first mesh to use a file queues its decode and the
+    // preparation of its layer on the texture loader, sharing the decode of the model's own texture if it is pending
+    unsigned int material(const Model &model, const Mesh &mesh)
+    {
+        string file;
+        for(unsigned int i = 0; i < mesh.textures.size(); i++)
+        {
+            if(mesh.textures[i].type == "texture_diffuse" && !mesh.textures[i].path.empty())
+            {
+                file = TextureManager::canonicalPath(model.directory + '/' + mesh.textures[i].path);
+                break;
+            }
+        }
+        if(file.empty())
+            return MATERIAL_UNTEXTURED;
+        map<string, unsigned int>::iterator found = materialIndex.find(file);
+        if(found != materialIndex.end())
+            return found->second;
+
+        std::shared_future<Image> decoded = TextureManager::get().image(file);
+        Material entry;
+        entry.file = file;
+        entry.image = TextureLoader::get().run([decoded]() { return layerImage(decoded.get()); });
+        entry.code = MATERIAL_UNTEXTURED;
+        materialIndex[file] = materials.size();
+        materials.push_back(entry);
+        return materials.size() - 1;
+    }
+
+    // sorts the prepared layers into arrays by size, format and mip count and allocates every level of them.
+    // everything was decoded, scaled and mipmapped on the loader, uploadMaterials() only copies it in.
+    void planTextureArrays()
+    {
+        for(unsigned int i = 0; i < materials.size(); i++)
+        {
+            Material &material = materials[i];
+            const Image &image = material.image.get();
+            if(!image.data || image.levels.empty())
+            {
+                std::cout << "Texture failed to load at path: " << material.file << std::endl;
+                continue;
+            }
+            GLenum format = image.compressedFormat ? image.compressedFormat : GL_RGBA8;
+            unsigned int a = 0;
+            while(a < arrays.size() && (arrays[a].format != format || arrays[a].width != image.width ||
+                                        arrays[a].height != image.height || arrays[a].levels != (int)image.levels.size()))
+                a++;
+            if(a == arrays.size())
+            {
+                if(arrays.size() == MAX_MATERIAL_ARRAYS)
+                {
+                    std::cout << "ERROR::MODEL_BATCH:: no texture array left for " << material.file << ", drawn white" << std::endl;
+                    continue;
+                }
+                MaterialArray created = { 0, format, image.width, image.height, (int)image.levels.size(), vector<unsigned int>() };
+                arrays.push_back(created);
+            }
+            material.code = (a << 16) | arrays[a].layers.size();
+            arrays[a].layers.push_back(i);
+        }
+
+        for(unsigned int a = 0; a < arrays.size(); a++)
+        {
+            MaterialArray &array = arrays[a];
+            GLsizei layerCount = array.layers.size();
+            glGenTextures(1, &array.texture);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+            const Image &first = materials[array.layers[0]].image.get();
+            for(int l = 0; l < array.levels; l++)
+            {
+                const ImageLevel &level = first.levels[l];
+                if(array.format == GL_RGBA8)
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA8, level.width, level.height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                else
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, array.format, level.width, level.height, layerCount, 0, level.size * layerCount, NULL);
+                textureBytes += level.size * layerCount;
+            }
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levels - 1);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, array.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // runs on the texture loader: turns a decoded image into the levels of a layer. a block compressed image keeps
+    // its prebuilt mip chain from the first level no larger than MAX_LAYER_SIZE on. any other image is expanded to
+    // RGBA, halved until it fits and gets its mip chain from a 2 x 2 box filter, all in one allocation.
+    static Image layerImage(const Image &source)
+    {
+        Image layer;
+        layer.path = source.path;
+        if(!source.data)
+            return layer;
+        if(source.compressedFormat != 0)
+        {
+            unsigned int first = 0;
+            while(first + 1 < source.levels.size() && std::max(source.levels[first].width, source.levels[first].height) > MAX_LAYER_SIZE)
+                first++;
+            layer = source;
+            layer.levels.assign(source.levels.begin() + first, source.levels.end());
+            layer.width = layer.levels[0].width;
+            layer.height = layer.levels[0].height;
+            return layer;
+        }
+
+        int width = source.width, height = source.height;
+        vector<unsigned char> top((size_t)width * height * 4);
+        const unsigned char *src = source.data.get();
+        for(size_t p = 0; p < (size_t)width * height; p++)
+        {
+            const unsigned char *in = src + p * source.components;
+            unsigned char *out = &top[p * 4];
+            // grey, grey and alpha, rgb or rgba
+            out[0] = in[0];
+            out[1] = source.components >= 3 ? in[1] : in[0];
+            out[2] = source.components >= 3 ? in[2] : in[0];
+            out[3] = source.components == 2 ? in[1] : source.components == 4 ? in[3] : 255;
+        }
+        while(std::max(width, height) > MAX_LAYER_SIZE)
+            top = halve(top, width, height);
+
+        layer.width = width;
+        layer.height = height;
+        layer.components = 4;
+        vector<vector<unsigned char> > chain(1, top);
+        while(width > 1 || height > 1)
+            chain.push_back(halve(chain.back(), width, height));
+        size_t total = 0;
+        for(unsigned int l = 0; l < chain.size(); l++)
+            total += chain[l].size();
+        layer.data.reset(new unsigned char[total], std::default_delete<unsigned char[]>());
+        size_t offset = 0;
+        int w = layer.width, h = layer.height;
+        for(unsigned int l = 0; l < chain.size(); l++)
+        {
+            ImageLevel level = { w, h, offset, chain[l].size() };
+            std::copy(chain[l].begin(), chain[l].end(), layer.data.get() + offset);
+            layer.levels.push_back(level);
+            offset += chain[l].size();
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        return layer;
+    }
+
+    // the next mip level of an RGBA image, each texel the average of the up to 2 x 2 texels below it
+    static vector<unsigned char> halve(const vector<unsigned char> &image, int &width, int &height)
+    {
+        int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+        vector<unsigned char> out((size_t)w * h * 4);
+        for(int y = 0; y < h; y++)
+        {
+            int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+            for(int x = 0; x < w; x++)
+            {
+                int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                for(int c = 0; c < 4; c++)
+                {
+                    unsigned int sum = image[(y0 * width + x0) * 4 + c] + image[(y0 * width + x1) * 4 + c] +
+                                       image[(y1 * width + x0) * 4 + c] + image[(y1 * width + x1) * 4 + c];
+                    out[(y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        width = w;
+        height = h;
+        return out;
+    }
+};
+#endif
@@ -4,97 +4,135 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// location of a uniform of type T, resolved once by Shader::uniform<T>() so per draw code
+// never looks anything up by name. a handle of a missing uniform holds -1, which GL ignores.
+template <typename T>
+struct UniformHandle
+{
+    GLint location;
+    UniformHandle() : location(-1) {}
+    explicit UniformHandle(GLint location) : location(location) {}
+};
+
+// GL types a handle of type T may point at
+inline bool uniformTypeMatches(GLenum type, const bool*)      { return type == GL_BOOL || type == GL_INT; }
+inline bool uniformTypeMatches(GLenum type, const float*)     { return type == GL_FLOAT; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec2*) { return type == GL_FLOAT_VEC2; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec3*) { return type == GL_FLOAT_VEC3; }
+inline bool uniformTypeMatches(GLenum type, const glm::vec4*) { return type == GL_FLOAT_VEC4; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat2*) { return type == GL_FLOAT_MAT2; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat3*) { return type == GL_FLOAT_MAT3; }
+inline bool uniformTypeMatches(GLenum type, const glm::mat4*) { return type == GL_FLOAT_MAT4; }
+inline bool uniformTypeMatches(GLenum type, const int*)
+{
+    // ints also set samplers and images, so everything but the float, double and vector types is accepted
+    switch(type)
+    {
+    case GL_FLOAT: case GL_FLOAT_VEC2: case GL_FLOAT_VEC3: case GL_FLOAT_VEC4:
+    case GL_FLOAT_MAT2: case GL_FLOAT_MAT3: case GL_FLOAT_MAT4:
+    case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3:
+    case GL_DOUBLE: case GL_DOUBLE_VEC2: case GL_DOUBLE_VEC3: case GL_DOUBLE_VEC4:
+    case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+    case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+    case GL_BOOL_VEC2: case GL_BOOL_VEC3: case GL_BOOL_VEC4:
+        return false;
+    default:
+        return true;
+    }
+}
+
+// one stage of a program: its type, the name used in compile errors and the GLSL source
+struct ShaderStage
+{
+    GLenum type;
+    const char *name;
+    std::string code;
+    ShaderStage(GLenum type, const char *name, const std::string &code) : type(type), name(name), code(code) {}
+};
+
+// linked programs are cached as driver binaries (GL 4.1, glGetProgramBinary) next to their first source file,
+// as <path>.<variant>.programcache. the variant hashes the paths of the stages and the defines, so every
+// combination of files and features has one file of its own. the key in the header hashes every stage's type and
+// source together with the vendor, renderer and version strings of the driver: an edited shader or an updated
+// driver misses the cache, compiles again and overwrites the same file, as does a binary the driver rejects.
+//   ProgramCacheHeader | binary
+const unsigned int PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int binaryFormat;
+    unsigned long long key;
+    unsigned long long binaryLength;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+
+    // an active uniform as reported by the linker
+    struct UniformInfo
+    {
+        GLint location;
+        GLenum type;
+        GLint size;     // number of array elements, 1 for plain uniforms
+    };
+    // constructor generates the shader on the fly. defines, one "#define NAME" per line, go right after the
+    // #version line of every stage, see shader_variants.h
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const char* tessControlPath = nullptr, const char* tessEvaluationPath = nullptr, const std::string &defines = std::string())
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+        // 1. retrieve the source code of every stage, with its includes resolved
+        std::string vertexCode = readSource(vertexPath, defines);
+        std::string fragmentCode = readSource(fragmentPath, defines);
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        std::string tessControlCode;
+        std::string tessEvaluationCode;
+        if(geometryPath != nullptr)
+            geometryCode = readSource(geometryPath, defines);
+        // if tessellation shader paths are present, also load both tessellation stages
+        if(tessControlPath != nullptr && tessEvaluationPath != nullptr)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            tessControlCode = readSource(tessControlPath, defines);
+            tessEvaluationCode = readSource(tessEvaluationPath, defines);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        // 2. compile shaders, unless the cache next to the vertex shader has this exact program
+        std::vector<ShaderStage> stages;
+        stages.push_back(ShaderStage(GL_VERTEX_SHADER, "VERTEX", vertexCode));
+        stages.push_back(ShaderStage(GL_FRAGMENT_SHADER, "FRAGMENT", fragmentCode));
         if(geometryPath != nullptr)
+            stages.push_back(ShaderStage(GL_GEOMETRY_SHADER, "GEOMETRY", geometryCode));
+        if(tessControlPath != nullptr && tessEvaluationPath != nullptr)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            stages.push_back(ShaderStage(GL_TESS_CONTROL_SHADER, "TESS_CONTROL", tessControlCode));
+            stages.push_back(ShaderStage(GL_TESS_EVALUATION_SHADER, "TESS_EVALUATION", tessEvaluationCode));
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        std::string variant = std::string(vertexPath) + "\n" + fragmentPath + "\n" + (geometryPath ? geometryPath : "") + "\n" +
+                              (tessControlPath ? tessControlPath : "") + "\n" + (tessEvaluationPath ? tessEvaluationPath : "") + "\n" + defines;
+        build(stages, vertexPath, variant);
+    }
+    // constructor of a compute program (GL 4.3), dispatched with glDispatchCompute after use()
+    // ------------------------------------------------------------------------
+    explicit Shader(const char* computePath, const std::string &defines = std::string())
+    {
+        std::string computeCode = readSource(computePath, defines);
+        std::vector<ShaderStage> stages;
+        stages.push_back(ShaderStage(GL_COMPUTE_SHADER, "COMPUTE", computeCode));
+        build(stages, computePath, std::string(computePath) + "\n" + defines);
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -102,66 +140,388 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // location of the active uniform name, -1 without a warning when the program has none.
+    // a hash lookup, no call into the driver.
+    GLint location(const std::string &name) const
+    {
+        std::unordered_map<std::string, UniformInfo>::const_iterator found = uniforms.find(name);
+        return found == uniforms.end() ? -1 : found->second.location;
+    }
+    // the reflected uniform name, null when the program has none
+    const UniformInfo *uniformInfo(const std::string &name) const
+    {
+        std::unordered_map<std::string, UniformInfo>::const_iterator found = uniforms.find(name);
+        return found == uniforms.end() ? NULL : &found->second;
+    }
+    // connects the uniform block name to a buffer binding point, false when the program has no such block
+    bool bindUniformBlock(const std::string &name, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if(index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
+    // every active uniform outside of uniform blocks; arrays are listed by their plain name and by element
+    const std::unordered_map<std::string, UniformInfo> &activeUniforms() const
+    {
+        return uniforms;
+    }
+    // resolves a typed handle for the hot paths, warning when the uniform is missing or of another type
+    template <typename T>
+    UniformHandle<T> uniform(const std::string &name) const
+    {
+        const UniformInfo *info = uniformInfo(name);
+        if(!info)
+        {
+            warnMissing(name);
+            return UniformHandle<T>();
+        }
+        if(!uniformTypeMatches(info->type, (const T*)NULL))
+            std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH: " << name << " (type 0x" << std::hex << info->type << std::dec << ")" << std::endl;
+        return UniformHandle<T>(info->location);
+    }
+    // typed uniform writes through pre-resolved handles
+    // ------------------------------------------------------------------------
+    void set(UniformHandle<bool> handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
+    }
+    void set(UniformHandle<int> handle, int value) const
+    {
+        glUniform1i(handle.location, value);
+    }
+    void set(UniformHandle<float> handle, float value) const
+    {
+        glUniform1f(handle.location, value);
+    }
+    void set(UniformHandle<glm::vec2> handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
+    }
+    void set(UniformHandle<glm::vec3> handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void set(UniformHandle<glm::vec4> handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void set(UniformHandle<glm::mat2> handle, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(UniformHandle<glm::mat3> handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(UniformHandle<glm::mat4> handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // utility uniform functions, looked up in the reflected table by name
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(checkedLocation(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(checkedLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(checkedLocation(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(checkedLocation(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(checkedLocation(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(checkedLocation(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(checkedLocation(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(checkedLocation(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(checkedLocation(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(checkedLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(checkedLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(checkedLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, UniformInfo> uniforms;
+    mutable std::unordered_set<std::string> warned;
+
+    // reads the GLSL file at path with every #include "file" line replaced by that file, looked up next to the file
+    // including it. each file is pasted once per stage, so includes need no guards. defines go after the #version line.
+    // #line directives keep compile errors pointing at the right line: source string 0 is path, n the n-th include.
+    static std::string readSource(const std::string &path, const std::string &defines)
+    {
+        std::string code;
+        std::vector<std::string> included;
+        appendSource(path, defines, code, included);
+        return code;
+    }
+    static void appendSource(const std::string &path, const std::string &defines, std::string &code, std::vector<std::string> &included)
+    {
+        std::string source = std::to_string(included.size());
+        included.push_back(path);
+        std::ifstream file(path.c_str());
+        if(!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return;
+        }
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        std::string line;
+        for(int number = 1; std::getline(file, line); number++)
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if(start != std::string::npos && line.compare(start, 8, "#version") == 0 && source == "0" && !defines.empty())
+            {
+                code += line + "\n" + defines + "#line " + std::to_string(number + 1) + " 0\n";
+                continue;
+            }
+            if(start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                code += line + "\n";
+                continue;
+            }
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if(close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << number << std::endl;
+                code += "\n";
+                continue;
+            }
+            std::string target = directory + line.substr(open + 1, close - open - 1);
+            if(std::find(included.begin(), included.end(), target) != included.end())
+            {
+                code += "\n";
+                continue;
+            }
+            code += "#line 1 " + std::to_string(included.size()) + "\n";
+            appendSource(target, std::string(), code, included);
+            code += "#line " + std::to_string(number + 1) + " " + source + "\n";
+        }
+    }
+    // links the stages into ID, from the binary cache beside cacheSource when it has the program.
+    // variant names the cache file, the stages decide whether its content is still good
+    void build(const std::vector<ShaderStage> &stages, const std::string &cacheSource, const std::string &variant)
+    {
+        unsigned long long key = programKey(stages);
+        std::string cache = cacheSource + "." + hexKey(hash(variant)) + ".programcache";
+        if(!loadBinary(cache, key))
+        {
+            ID = glCreateProgram();
+            std::vector<unsigned int> shaders;
+            for(size_t i = 0; i < stages.size(); i++)
+            {
+                const char *code = stages[i].code.c_str();
+                unsigned int shader = glCreateShader(stages[i].type);
+                glShaderSource(shader, 1, &code, NULL);
+                glCompileShader(shader);
+                checkCompileErrors(shader, stages[i].name);
+                glAttachShader(ID, shader);
+                shaders.push_back(shader);
+            }
+            if(binaryCacheSupported())
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessery
+            for(size_t i = 0; i < shaders.size(); i++)
+                glDeleteShader(shaders[i]);
+            saveBinary(cache, key);
+        }
+        reflectUniforms();
+    }
+    static bool binaryCacheSupported()
+    {
+        if(!GLAD_GL_VERSION_4_1)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+    // 64 bit FNV-1a
+    static unsigned long long hash(const std::string &text)
+    {
+        unsigned long long value = 14695981039346656037ull;
+        for(size_t i = 0; i < text.size(); i++)
+        {
+            value ^= (unsigned char)text[i];
+            value *= 1099511628211ull;
+        }
+        return value;
+    }
+    // hash of the stages and the driver strings
+    static unsigned long long programKey(const std::vector<ShaderStage> &stages)
+    {
+        std::string text;
+        for(size_t i = 0; i < stages.size(); i++)
+            text += std::to_string(stages[i].type) + ":" + stages[i].code + "\n";
+        const GLenum strings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for(int i = 0; i < 3; i++)
+        {
+            const GLubyte *value = glGetString(strings[i]);
+            text += std::string(value ? (const char*)value : "") + "\n";
+        }
+        return hash(text);
+    }
+    static std::string hexKey(unsigned long long key)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", key);
+        return text;
+    }
+    // creates ID from the cached binary, false with nothing created when it is missing, stale or refused
+    bool loadBinary(const std::string &path, unsigned long long key)
+    {
+        if(!binaryCacheSupported())
+            return false;
+        std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+        if(!file)
+            return false;
+        std::vector<char> data((size_t)file.tellg());
+        file.seekg(0);
+        if(data.size() < sizeof(ProgramCacheHeader) || !file.read(&data[0], data.size()))
+            return false;
+        ProgramCacheHeader header;
+        memcpy(&header, &data[0], sizeof(header));
+        if(memcmp(header.magic, "PROGBIN", 8) != 0 || header.version != PROGRAM_CACHE_VERSION || header.key != key ||
+           header.binaryLength != data.size() - sizeof(header))
+            return false;
+
+        ID = glCreateProgram();
+        glProgramBinary(ID, header.binaryFormat, &data[sizeof(header)], (GLsizei)header.binaryLength);
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if(!success)
+        {
+            glDeleteProgram(ID);
+            ID = 0;
+            return false;
+        }
+        return true;
+    }
+    // writes the binary of the linked ID, through a temporary file so a crash never leaves a torn cache
+    void saveBinary(const std::string &path, unsigned long long key) const
+    {
+        GLint success = 0, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if(!success || !binaryCacheSupported())
+            return;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+            return;
+        std::vector<char> data(sizeof(ProgramCacheHeader) + length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(ID, length, &written, &format, &data[sizeof(ProgramCacheHeader)]);
+        if(written <= 0)
+            return;
+        data.resize(sizeof(ProgramCacheHeader) + written);
+
+        ProgramCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "PROGBIN", 8);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.binaryFormat = format;
+        header.key = key;
+        header.binaryLength = written;
+        memcpy(&data[0], &header, sizeof(header));
+
+        std::string temporary = path + ".tmp";
+        std::ofstream file(temporary.c_str(), std::ios::binary | std::ios::trunc);
+        if(!file.write(&data[0], data.size()))
+            return;
+        file.close();
+        std::remove(path.c_str());
+        if(std::rename(temporary.c_str(), path.c_str()) != 0)
+            std::cout << "ERROR::SHADER::PROGRAM_CACHE: could not write " << path << std::endl;
+    }
+
+    // lists every active uniform once after linking, so no set call has to ask the driver again
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string buffer(maxLength > 0 ? maxLength : 1, '\0');
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            UniformInfo info;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)buffer.size(), &length, &info.size, &info.type, &buffer[0]);
+            std::string name(buffer.c_str(), length);
+            info.location = glGetUniformLocation(ID, name.c_str());
+            if(info.location < 0)
+                continue;  // member of a uniform block, set through its buffer
+            // arrays are reported as "name[0]": register the plain name and every element
+            size_t bracket = name.find('[');
+            if(bracket == std::string::npos)
+            {
+                uniforms[name] = info;
+                continue;
+            }
+            std::string base = name.substr(0, bracket);
+            uniforms[base] = info;
+            for(GLint element = 0; element < info.size; element++)
+            {
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                UniformInfo elementInfo = info;
+                elementInfo.location = glGetUniformLocation(ID, elementName.c_str());
+                elementInfo.size = info.size - element;
+                uniforms[elementName] = elementInfo;
+            }
+        }
+    }
+    // location for a set call by name, writes to uniforms the program does not have are reported once
+    GLint checkedLocation(const std::string &name) const
+    {
+        std::unordered_map<std::string, UniformInfo>::const_iterator found = uniforms.find(name);
+        if(found != uniforms.end())
+            return found->second.location;
+        warnMissing(name);
+        return -1;
+    }
+    void warnMissing(const std::string &name) const
+    {
+        if(warned.insert(name).second)
+            std::cout << "WARNING::SHADER::UNIFORM_NOT_FOUND: " << name << " (program " << ID << ")" << std::endl;
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,82 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+// features a shader source can be specialized for. each set bit becomes "#define NAME" in every stage, so the source
+// keeps the feature under #ifdef NAME and the compiled variant holds only what it uses.
+enum ShaderFeature
+{
+    SHADER_EXPLODE    = 1 << 0,     // triangles fly apart along their face normal (man_batch.vs)
+    SHADER_INSTANCED  = 1 << 1      // model matrix from the per instance attributes 5 ~ 8 instead of a uniform
+};
+
+const int SHADER_FEATURE_COUNT = 2;
+const char *const SHADER_FEATURE_NAMES[SHADER_FEATURE_COUNT] = { "EXPLODE", "INSTANCED" };
+
+// the #define lines for a set of ShaderFeature bits
+inline std::string shaderFeatureDefines(unsigned int features)
+{
+    std::string defines;
+    for(int i = 0; i < SHADER_FEATURE_COUNT; i++)
+        if(features & (1u << i))
+            defines += std::string("#define ") + SHADER_FEATURE_NAMES[i] + "\n";
+    return defines;
+}
+
+// one set of source files compiled into a Shader per combination of features, the first time that combination is
+// asked for. every variant goes through the program binary cache on its own key, so after the first run a variant
+// costs a file read. setup runs once on every new variant, e.g. to attach its uniform blocks.
+class ShaderVariants
+{
+public:
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr,
+                   const char *tessControlPath = nullptr, const char *tessEvaluationPath = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : ""),
+          tessControlPath(tessControlPath ? tessControlPath : ""), tessEvaluationPath(tessEvaluationPath ? tessEvaluationPath : "") {}
+
+    void setSetup(const std::function<void(Shader&)> &function)
+    {
+        setup = function;
+    }
+
+    // the variant compiled with features, a bitmask of ShaderFeature
+    Shader &get(unsigned int features)
+    {
+        std::map<unsigned int, std::unique_ptr<Shader> >::iterator found = variants.find(features);
+        if(found != variants.end())
+            return *found->second;
+        Shader *shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), optional(geometryPath), optional(tessControlPath),
+                                    optional(tessEvaluationPath), shaderFeatureDefines(features));
+        variants[features].reset(shader);
+        if(setup)
+            setup(*shader);
+        return *shader;
+    }
+
+    // variants compiled so far
+    size_t size() const
+    {
+        return variants.size();
+    }
+
+private:
+    std::string vertexPath, fragmentPath, geometryPath, tessControlPath, tessEvaluationPath;
+    std::function<void(Shader&)> setup;
+    std::map<unsigned int, std::unique_ptr<Shader> > variants;
+
+    ShaderVariants(const ShaderVariants&);
+    ShaderVariants &operator=(const ShaderVariants&);
+
+    static const char *optional(const std::string &path)
+    {
+        return path.empty() ? nullptr : path.c_str();
+    }
+};
+
+#endif
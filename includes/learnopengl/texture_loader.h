@@ -0,0 +1,312 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+// S3TC is an extension rather than core, but it is available on every desktop driver
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// one mip level of a block compressed image, offset and size are in bytes into Image::data
+struct ImageLevel
+{
+    int width;
+    int height;
+    size_t offset;
+    size_t size;
+};
+
+// a decoded image, the pixels are released once the last copy goes away.
+// block compressed images (compressedFormat != 0) come with all of their mip levels. uncompressed ones only hold
+// their top level, unless they were prepared for a texture array (see ModelBatch), which fills levels for them too.
+struct Image
+{
+    std::shared_ptr<unsigned char> data;
+    int width;
+    int height;
+    int components;
+    std::string path;
+    GLenum compressedFormat;
+    std::vector<ImageLevel> levels;
+
+    Image() : width(0), height(0), components(0), compressedFormat(0) {}
+};
+
+// reads a .dds file holding BC1 (DXT1), BC3 (DXT5), BC4, BC5 or BC7 blocks, legacy or DX10 header.
+// returns false for anything else, the caller then falls back to the source image.
+inline bool loadDDS(const std::string &path, Image &image)
+{
+    std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+    if(!file)
+        return false;
+    size_t size = (size_t)file.tellg();
+    if(size < 128)
+        return false;
+    std::shared_ptr<unsigned char> data(new unsigned char[size], std::default_delete<unsigned char[]>());
+    const unsigned char *bytes = data.get();
+    file.seekg(0);
+    if(!file.read((char*)data.get(), size) || memcmp(bytes, "DDS ", 4) != 0)
+        return false;
+
+    // DDS_HEADER fields, as little endian dwords after the magic
+    const unsigned char *header = bytes + 4;
+    unsigned int fields[31];
+    memcpy(fields, header, sizeof(fields));
+    unsigned int height = fields[2];
+    unsigned int width = fields[3];
+    unsigned int mipCount = fields[6] ? fields[6] : 1;
+    const char *fourCC = (const char*)&header[80];
+    size_t offset = 128;
+
+    GLenum format = 0;
+    if(memcmp(fourCC, "DXT1", 4) == 0)
+        format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    else if(memcmp(fourCC, "DXT5", 4) == 0)
+        format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else if(memcmp(fourCC, "ATI1", 4) == 0 || memcmp(fourCC, "BC4U", 4) == 0)
+        format = GL_COMPRESSED_RED_RGTC1;
+    else if(memcmp(fourCC, "ATI2", 4) == 0 || memcmp(fourCC, "BC5U", 4) == 0)
+        format = GL_COMPRESSED_RG_RGTC2;
+    else if(memcmp(fourCC, "DX10", 4) == 0 && size >= 148)
+    {
+        unsigned int dxgiFormat;
+        memcpy(&dxgiFormat, bytes + 128, sizeof(dxgiFormat));
+        offset = 148;
+        switch(dxgiFormat)
+        {
+            case 71: format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;  // DXGI_FORMAT_BC1_UNORM
+            case 77: format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;  // DXGI_FORMAT_BC3_UNORM
+            case 80: format = GL_COMPRESSED_RED_RGTC1; break;           // DXGI_FORMAT_BC4_UNORM
+            case 83: format = GL_COMPRESSED_RG_RGTC2; break;            // DXGI_FORMAT_BC5_UNORM
+            case 98: format = GL_COMPRESSED_RGBA_BPTC_UNORM; break;     // DXGI_FORMAT_BC7_UNORM
+        }
+    }
+    if(format == 0 || width == 0 || height == 0)
+        return false;
+
+    size_t blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+    image.levels.clear();
+    int w = width, h = height;
+    for(unsigned int i = 0; i < mipCount && (w > 0 || h > 0); i++)
+    {
+        ImageLevel level;
+        level.width = std::max(w, 1);
+        level.height = std::max(h, 1);
+        level.offset = offset;
+        level.size = ((level.width + 3) / 4) * ((level.height + 3) / 4) * blockSize;
+        if(offset + level.size > size)
+            return false;
+        image.levels.push_back(level);
+        offset += level.size;
+        w /= 2;
+        h /= 2;
+    }
+
+    image.data = data;
+    image.width = width;
+    image.height = height;
+    image.components = (format == GL_COMPRESSED_RED_RGTC1) ? 1 : (format == GL_COMPRESSED_RG_RGTC2) ? 2 : 4;
+    image.compressedFormat = format;
+    image.path = path;
+    return true;
+}
+
+// decodes image files on a pool of worker threads.
+// decode() returns immediately with a future, only the upload of the result has to happen on the GL thread.
+class TextureLoader
+{
+public:
+    // the process wide loader, one worker per hardware thread
+    static TextureLoader &get()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // queues the decode of an image file. channels forces the number of components of the result,
+    // which rules out a block compressed .dds sibling, 0 keeps what the file has.
+    std::shared_future<Image> decode(const std::string &path, int channels = 0)
+    {
+        return run(std::bind(&TextureLoader::decodeFile, path, channels));
+    }
+
+    // queues any other work producing an image, e.g. the processing of a decode. tasks start in the order they
+    // were queued, so a task may wait for a decode queued before it without ever holding up that decode's worker.
+    std::shared_future<Image> run(const std::function<Image()> &function)
+    {
+        std::shared_ptr<std::packaged_task<Image()> > task(new std::packaged_task<Image()>(function));
+        std::shared_future<Image> result = task->get_future().share();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(unsigned int i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    TextureLoader() : stopping(false)
+    {
+        unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+        for(unsigned int i = 0; i < count; i++)
+            workers.push_back(std::thread(&TextureLoader::work, this));
+    }
+    TextureLoader(const TextureLoader&);
+    TextureLoader &operator=(const TextureLoader&);
+
+    void work()
+    {
+        for(;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if(stopping && tasks.empty())
+                    return;
+                task = tasks.front();
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    // a transcoded <name>.dds next to the source image is preferred, it needs no decoding and no mipmap generation
+    static Image decodeFile(const std::string &path, int channels)
+    {
+        Image image;
+        size_t dot = path.find_last_of('.');
+        if(channels == 0 && dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos && path.compare(dot, std::string::npos, ".dds") != 0 &&
+           loadDDS(path.substr(0, dot) + ".dds", image))
+            return image;
+
+        image.path = path;
+        unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, channels);
+        if(data)
+            image.data.reset(data, stbi_image_free);
+        if(channels != 0)
+            image.components = channels;
+        return image;
+    }
+};
+
+// uploads a decoded image into the given texture and builds its mipmaps, GL thread only.
+// returns the video memory the texture takes, mip chain included.
+inline size_t uploadTexture2D(unsigned int textureID, const Image &image)
+{
+    if(!image.data)
+    {
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
+        return 0;
+    }
+
+    if(image.compressedFormat != 0)
+    {
+        // every mip level comes precomputed from the file
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        for(unsigned int i = 0; i < image.levels.size(); i++)
+        {
+            const ImageLevel &level = image.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image.compressedFormat, level.width, level.height, 0, level.size, image.data.get() + level.offset);
+        }
+        size_t bytes = 0;
+        for(unsigned int i = 0; i < image.levels.size(); i++)
+            bytes += image.levels[i].size;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return bytes;
+    }
+
+    GLenum format = GL_RGB;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data.get());
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // a full mip chain adds a third on top of the base level
+    return (size_t)image.width * image.height * (image.components == 3 ? 4 : image.components) * 4 / 3;
+}
+
+// uploads the six faces of a cubemap (+x, -x, +y, -y, +z, -z), GL thread only.
+// returns the video memory the texture takes.
+inline size_t uploadCubemap(unsigned int textureID, const std::vector<std::shared_future<Image> > &faces)
+{
+    size_t bytes = 0;
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    for(unsigned int i = 0; i < faces.size(); i++)
+    {
+        const Image &image = faces[i].get();
+        if(image.data && image.compressedFormat != 0)
+        {
+            // a transcoded face only needs its top level, the cubemap is sampled without mipmaps
+            const ImageLevel &level = image.levels[0];
+            glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, image.compressedFormat, level.width, level.height, 0, level.size, image.data.get() + level.offset);
+            bytes += level.size;
+        }
+        else if(image.data)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data.get());
+            bytes += (size_t)image.width * image.height * 4;
+        }
+        else
+            std::cout << "Cubemap texture failed to load at path: " << image.path << std::endl;
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    return bytes;
+}
+
+#endif
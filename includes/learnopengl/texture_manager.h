@@ -0,0 +1,230 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/texture_loader.h>
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// process wide registry of textures, keyed by canonical file path.
+// the same file is decoded and uploaded once no matter how many models, materials or scene objects use it.
+// every acquire() has to be paired with a release(), the texture is deleted when the last user releases it.
+// all members touch GL state and must be called from the GL thread.
+class TextureManager
+{
+public:
+    static TextureManager &get()
+    {
+        static TextureManager manager;
+        return manager;
+    }
+
+    // returns the GL_TEXTURE_2D for path. a new texture gets its id right away, its image is decoded
+    // on the texture loader and uploaded by the next uploadPending().
+    unsigned int acquire(const std::string &path)
+    {
+        std::vector<std::string> files(1, canonicalPath(path));
+        return acquire(files[0], GL_TEXTURE_2D, files);
+    }
+
+    // returns the cubemap built from the six faces (+x, -x, +y, -y, +z, -z)
+    unsigned int acquireCubemap(const std::vector<std::string> &faces)
+    {
+        std::vector<std::string> files;
+        std::string key = "cubemap:";
+        for(unsigned int i = 0; i < faces.size(); i++)
+        {
+            files.push_back(canonicalPath(faces[i]));
+            key += files.back() + ";";
+        }
+        return acquire(key, GL_TEXTURE_CUBE_MAP, files);
+    }
+
+    // the decoded image of a file, for callers that build textures of their own, like the arrays of a ModelBatch.
+    // a texture of the same file that still waits for its upload shares its decode, otherwise the file is queued anew
+    std::shared_future<Image> image(const std::string &path)
+    {
+        std::string key = canonicalPath(path);
+        std::unordered_map<std::string, Entry>::iterator found = entries.find(key);
+        if(found != entries.end() && found->second.target == GL_TEXTURE_2D && !found->second.images.empty())
+            return found->second.images[0];
+        return TextureLoader::get().decode(key);
+    }
+
+    void release(unsigned int textureID)
+    {
+        std::unordered_map<unsigned int, std::string>::iterator path = paths.find(textureID);
+        if(path == paths.end())
+            return;
+        std::unordered_map<std::string, Entry>::iterator entry = entries.find(path->second);
+        if(--entry->second.references > 0)
+            return;
+
+        glDeleteTextures(1, &textureID);
+        resident -= entry->second.bytes;
+        entries.erase(entry);
+        paths.erase(path);
+    }
+
+    // a 1 x 1 opaque white texture, for meshes without a diffuse map to sample instead of whatever was left on the
+    // unit. shared and released like the textures of files
+    unsigned int acquireWhite()
+    {
+        std::unordered_map<std::string, Entry>::iterator found = entries.find("white:");
+        if(found != entries.end())
+        {
+            found->second.references++;
+            return found->second.id;
+        }
+
+        const unsigned char texel[4] = { 255, 255, 255, 255 };
+        Entry entry;
+        glGenTextures(1, &entry.id);
+        entry.references = 1;
+        entry.target = GL_TEXTURE_2D;
+        entry.bytes = sizeof(texel);
+        glBindTexture(GL_TEXTURE_2D, entry.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        entries["white:"] = entry;
+        paths[entry.id] = "white:";
+        resident += entry.bytes;
+        return entry.id;
+    }
+
+    // uploads every texture whose decode was queued since the last call, waiting for the ones still running
+    void uploadPending()
+    {
+        upload(true);
+    }
+
+    // uploads the queued textures whose decode has finished and leaves the rest for a later call, so it never blocks.
+    // until then a texture is incomplete and samples as black.
+    void uploadReady()
+    {
+        upload(false);
+    }
+
+    // video memory held by all uploaded textures
+    size_t residentBytes() const
+    {
+        return resident;
+    }
+
+    size_t textureCount() const
+    {
+        return entries.size();
+    }
+
+    // collapses "//", "/./" and "dir/../" and unifies separators, so different spellings of a path share an entry
+    static std::string canonicalPath(const std::string &path)
+    {
+        std::vector<std::string> parts;
+        std::string part;
+        bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+        for(size_t i = 0; i <= path.size(); i++)
+        {
+            if(i < path.size() && path[i] != '/' && path[i] != '\\')
+            {
+                part += path[i];
+                continue;
+            }
+            if(part == "..")
+            {
+                if(!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if(!absolute)
+                    parts.push_back(part);
+            }
+            else if(!part.empty() && part != ".")
+                parts.push_back(part);
+            part.clear();
+        }
+
+        std::string result = absolute ? "/" : "";
+        for(unsigned int i = 0; i < parts.size(); i++)
+            result += (i > 0 ? "/" : "") + parts[i];
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned int id;
+        unsigned int references;
+        GLenum target;
+        size_t bytes;
+        std::vector<std::shared_future<Image> > images;  // decodes not uploaded yet
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<unsigned int, std::string> paths;
+    std::vector<std::string> pending;
+    size_t resident;
+
+    TextureManager() : resident(0) {}
+    TextureManager(const TextureManager&);
+    TextureManager &operator=(const TextureManager&);
+
+    void upload(bool wait)
+    {
+        std::vector<std::string> waiting;
+        for(unsigned int i = 0; i < pending.size(); i++)
+        {
+            std::unordered_map<std::string, Entry>::iterator entry = entries.find(pending[i]);
+            if(entry == entries.end() || entry->second.images.empty())
+                continue;  // released before it was ever uploaded
+            Entry &texture = entry->second;
+            if(!wait && !decoded(texture))
+            {
+                waiting.push_back(pending[i]);
+                continue;
+            }
+            if(texture.target == GL_TEXTURE_CUBE_MAP)
+                texture.bytes = uploadCubemap(texture.id, texture.images);
+            else
+                texture.bytes = uploadTexture2D(texture.id, texture.images[0].get());
+            texture.images.clear();
+            resident += texture.bytes;
+        }
+        pending.swap(waiting);
+    }
+
+    static bool decoded(const Entry &texture)
+    {
+        for(unsigned int i = 0; i < texture.images.size(); i++)
+            if(texture.images[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+        return true;
+    }
+
+    unsigned int acquire(const std::string &key, GLenum target, const std::vector<std::string> &files)
+    {
+        std::unordered_map<std::string, Entry>::iterator found = entries.find(key);
+        if(found != entries.end())
+        {
+            found->second.references++;
+            return found->second.id;
+        }
+
+        Entry entry;
+        glGenTextures(1, &entry.id);
+        entry.references = 1;
+        entry.target = target;
+        entry.bytes = 0;
+        for(unsigned int i = 0; i < files.size(); i++)
+            entry.images.push_back(TextureLoader::get().decode(files[i]));
+        entries[key] = entry;
+        paths[entry.id] = key;
+        pending.push_back(key);
+        return entry.id;
+    }
+};
+#endif
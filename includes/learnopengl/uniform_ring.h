@@ -0,0 +1,153 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// std140 layout of the Frame block the scene shaders include (frame.glsl in the amusement park):
+//   layout (std140) uniform Frame {
+//       mat4 view;
+//       mat4 projection;
+//       mat4 viewProjection;
+//       vec3 cameraPosition;
+//       float time;
+//       vec2 viewport;
+//   };
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec3 cameraPosition;   // a vec3 takes 16 bytes in std140, time fills the last 4
+    float time;
+    glm::vec2 viewport;
+    float padding[2];           // blocks are rounded up to 16 bytes
+};
+static_assert(sizeof(FrameData) == 224, "FrameData out of sync with the std140 layout of Frame");
+
+// binding points the blocks are attached to, see UniformRing::attach()
+const GLuint FRAME_BLOCK_BINDING = 0;
+const GLuint OBJECT_BLOCK_BINDING = 1;
+
+// one uniform buffer for everything that changes per frame or per draw. every bind() copies a block into the next
+// free slice and points a binding at it with glBindBufferRange, so programs sharing a block read the same bytes
+// and switching programs uploads nothing. the buffer is split into one region per frame in flight, a region is
+// reused only after the fence set by endFrame() for it has passed, framesInFlight frames later, so writes never wait on the gpu
+// and need no orphaning.
+class UniformRing
+{
+public:
+    // cap of the blocks bound between beginFrame() and endFrame()
+    UniformRing(GLsizeiptr bytesPerFrame = 64 * 1024, int framesInFlight = 3)
+        : buffer(0), alignment(256), regionSize(0), frame(0), head(0), end(0), warned(false)
+    {
+        GLint offsetAlignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        if(offsetAlignment > 0)
+            alignment = offsetAlignment;
+        regionSize = align(bytesPerFrame);
+        fences.assign(framesInFlight, (GLsync)0);
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, regionSize * framesInFlight, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    ~UniformRing()
+    {
+        for(size_t i = 0; i < fences.size(); i++)
+            if(fences[i])
+                glDeleteSync(fences[i]);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    // moves on to the next region, waiting for the gpu only if it is still reading it
+    void beginFrame()
+    {
+        frame = (frame + 1) % fences.size();
+        if(fences[frame])
+        {
+            GLenum status = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+            while(status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(fences[frame], 0, FENCE_TIMEOUT);
+            glDeleteSync(fences[frame]);
+            fences[frame] = 0;
+        }
+        head = frame * regionSize;
+        end = head + regionSize;
+    }
+
+    // after the last draw reading this frame's blocks
+    void endFrame()
+    {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // copies data, laid out as std140, into the ring and binds it to binding for the following draws
+    template <typename T>
+    bool bind(GLuint binding, const T &data)
+    {
+        return bind(binding, &data, sizeof(T));
+    }
+
+    bool bind(GLuint binding, const void *data, GLsizeiptr size)
+    {
+        GLintptr offset = align(head);
+        if(offset + size > end)
+        {
+            if(!warned)
+                std::cout << "ERROR::UNIFORM_RING:: more than " << regionSize << " bytes of uniforms in one frame" << std::endl;
+            warned = true;
+            return false;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        // the fence in beginFrame() already made sure the gpu is done with this range
+        void *target = glMapBufferRange(GL_UNIFORM_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if(target)
+        {
+            memcpy(target, data, size);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, size);
+        head = offset + size;
+        return target != NULL;
+    }
+
+    // points the Frame and Object blocks of shader, where it has them, at their binding points.
+    // GLSL 3.30 has no binding layout qualifier for blocks, so this is done once per program after linking.
+    static void attach(const Shader &shader)
+    {
+        shader.bindUniformBlock("Frame", FRAME_BLOCK_BINDING);
+        shader.bindUniformBlock("Object", OBJECT_BLOCK_BINDING);
+    }
+
+private:
+    static const GLuint64 FENCE_TIMEOUT = 1000000000;  // ns
+
+    unsigned int buffer;
+    GLintptr alignment;
+    GLsizeiptr regionSize;
+    size_t frame;
+    GLintptr head, end;         // next free byte and end of the current region
+    std::vector<GLsync> fences; // per region, set when its frame was submitted
+    bool warned;
+
+    UniformRing(const UniformRing&);
+    UniformRing &operator=(const UniformRing&);
+
+    GLintptr align(GLintptr value) const
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+};
+
+#endif
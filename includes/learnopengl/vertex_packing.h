@@ -0,0 +1,260 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// layout of the vertex buffer a mesh is uploaded with. the cpu side always keeps the full Vertex.
+//   VERTEX_FLOAT             56 bytes, Vertex as it is
+//   VERTEX_PACKED            24 bytes, float position, octahedral normal and tangent, half float uv
+//   VERTEX_PACKED_QUANTIZED  20 bytes, like VERTEX_PACKED with 16 bit positions inside the mesh bounds
+// packed normals and tangents have to be decoded in the vertex shader:
+//   vec3 octDecode(vec2 e) {
+//       vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//       if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * sign(v.xy);
+//       return normalize(v);
+//   }
+//   normal    = octDecode(aNormal.xy);                                       // location 1
+//   float s   = aTangent.y < 0.0 ? -1.0 : 1.0;                               // location 3
+//   tangent   = octDecode(vec2(aTangent.x, (abs(aTangent.y) - e) / (1.0 - e) * 2.0 - 1.0));  // e = 1 / 32767
+//   bitangent = s * cross(normal, tangent);
+// quantized positions arrive in [0, 1] and are mapped back by the mesh's positionTransform.
+enum VertexFormat
+{
+    VERTEX_FLOAT,
+    VERTEX_PACKED,
+    VERTEX_PACKED_QUANTIZED
+};
+
+// size and attribute offsets of the full float Vertex in mesh.h, which checks them against the struct
+const size_t VERTEX_FLOAT_SIZE = 56;
+const size_t VERTEX_FLOAT_OFFSETS[5] = { 0, 12, 24, 32, 44 };
+
+struct PackedVertex
+{
+    float Position[3];
+    short NormalTangent[4];     // snorm16: octahedral normal, octahedral tangent with the bitangent sign folded into w
+    unsigned short TexCoords[2];  // half float
+};
+
+struct QuantizedVertex
+{
+    unsigned short Position[4]; // unorm16 inside the mesh bounds, w unused
+    short NormalTangent[4];
+    unsigned short TexCoords[2];
+};
+
+inline size_t vertexSize(VertexFormat format)
+{
+    switch(format)
+    {
+    case VERTEX_PACKED:           return sizeof(PackedVertex);
+    case VERTEX_PACKED_QUANTIZED: return sizeof(QuantizedVertex);
+    default:                      return VERTEX_FLOAT_SIZE;
+    }
+}
+
+// float to IEEE half, rounding to nearest even. out of range values become infinity
+inline unsigned short floatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mantissa = bits & 0x7fffff;
+
+    if(((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);  // inf or nan
+    if(exponent >= 31)
+        return sign | 0x7c00;
+    if(exponent <= 0)
+    {
+        if(exponent < -10)
+            return sign;  // too small even for a denormal
+        mantissa |= 0x800000;
+        unsigned int shift = 14 - exponent;
+        unsigned int half = mantissa >> shift;
+        unsigned int rest = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+    unsigned int rest = mantissa & 0x1fff;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;  // may carry into the exponent, which is still the right rounding
+    return half;
+}
+
+inline short toSnorm16(float value)
+{
+    return (short)std::floor(glm::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f);
+}
+
+// maps a unit vector onto the [-1, 1] square by folding the lower hemisphere over the upper one
+inline glm::vec2 octEncode(glm::vec3 v)
+{
+    float length = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if(length < 1e-12f)
+        return glm::vec2(0.0f);  // no direction, decodes to +z
+    v /= length;
+    glm::vec2 e(v.x, v.y);
+    if(v.z < 0.0f)
+        e = glm::vec2((1.0f - std::fabs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+    return e;
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+    glm::vec3 v(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if(v.z < 0.0f)
+        v = glm::vec3((1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f), v.z);
+    return glm::normalize(v);
+}
+
+// normal, tangent and the handedness of the bitangent in four snorm16.
+// the sign can not live in the sign of a plain oct coordinate (it is signed itself), so the tangent's
+// second coordinate is remapped to [e, 1] first and the sign applied on top, e keeping 0 out of the range.
+inline void packTangentFrame(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent, short out[4])
+{
+    const float e = 1.0f / 32767.0f;
+    glm::vec2 n = octEncode(normal);
+    glm::vec2 t = octEncode(tangent);
+    float sign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+    out[0] = toSnorm16(n.x);
+    out[1] = toSnorm16(n.y);
+    out[2] = toSnorm16(t.x);
+    out[3] = toSnorm16(sign * ((t.y * 0.5f + 0.5f) * (1.0f - e) + e));
+}
+
+// converts vertices to format and appends them to out.
+// for quantized positions, transform receives the matrix that maps the stored [0, 1] cube back onto the mesh.
+template <typename VertexType>
+void packVertices(const std::vector<VertexType> &vertices, VertexFormat format, std::vector<unsigned char> &out, glm::mat4 &transform)
+{
+    transform = glm::mat4(1.0f);
+    size_t start = out.size();
+    size_t stride = vertexSize(format);
+    out.resize(start + vertices.size() * stride);
+    if(vertices.empty())
+        return;
+    if(format == VERTEX_FLOAT)
+    {
+        memcpy(&out[start], &vertices[0], vertices.size() * sizeof(VertexType));
+        return;
+    }
+
+    glm::vec3 lower = vertices[0].Position, upper = vertices[0].Position;
+    for(size_t i = 1; i < vertices.size(); i++)
+    {
+        lower = glm::min(lower, vertices[i].Position);
+        upper = glm::max(upper, vertices[i].Position);
+    }
+    glm::vec3 extent = upper - lower;
+    for(int c = 0; c < 3; c++)
+        if(extent[c] <= 0.0f)
+            extent[c] = 1.0f;
+    if(format == VERTEX_PACKED_QUANTIZED)
+        transform = glm::scale(glm::translate(glm::mat4(1.0f), lower), extent);
+
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        const VertexType &vertex = vertices[i];
+        short frame[4];
+        packTangentFrame(vertex.Normal, vertex.Tangent, vertex.Bitangent, frame);
+        unsigned short uv[2] = { floatToHalf(vertex.TexCoords.x), floatToHalf(vertex.TexCoords.y) };
+        unsigned char *dst = &out[start + i * stride];
+        if(format == VERTEX_PACKED)
+        {
+            PackedVertex packed;
+            for(int c = 0; c < 3; c++)
+                packed.Position[c] = vertex.Position[c];
+            memcpy(packed.NormalTangent, frame, sizeof(frame));
+            memcpy(packed.TexCoords, uv, sizeof(uv));
+            memcpy(dst, &packed, sizeof(packed));
+        }
+        else
+        {
+            QuantizedVertex packed;
+            glm::vec3 q = (vertex.Position - lower) / extent;
+            for(int c = 0; c < 3; c++)
+                packed.Position[c] = (unsigned short)std::floor(glm::clamp(q[c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+            packed.Position[3] = 0;
+            memcpy(packed.NormalTangent, frame, sizeof(frame));
+            memcpy(packed.TexCoords, uv, sizeof(uv));
+            memcpy(dst, &packed, sizeof(packed));
+        }
+    }
+}
+
+// points attributes 0 ~ 4 of the bound VAO at the bound GL_ARRAY_BUFFER holding vertices of format.
+// the packed formats have no bitangent attribute, its sign rides along with the tangent.
+inline void setupVertexAttributes(VertexFormat format, size_t offset = 0)
+{
+    if(format == VERTEX_FLOAT)
+    {
+        // vertex Positions, normals, texture coords, tangent and bitangent, see Vertex
+        const GLint sizes[5] = { 3, 3, 2, 3, 3 };
+        for(GLuint i = 0; i < 5; i++)
+        {
+            glEnableVertexAttribArray(i);
+            glVertexAttribPointer(i, sizes[i], GL_FLOAT, GL_FALSE, VERTEX_FLOAT_SIZE, (void*)(offset + VERTEX_FLOAT_OFFSETS[i]));
+        }
+        return;
+    }
+
+    bool quantized = format == VERTEX_PACKED_QUANTIZED;
+    GLsizei stride = vertexSize(format);
+    size_t frame = quantized ? offsetof(QuantizedVertex, NormalTangent) : offsetof(PackedVertex, NormalTangent);
+    size_t uv = quantized ? offsetof(QuantizedVertex, TexCoords) : offsetof(PackedVertex, TexCoords);
+    glEnableVertexAttribArray(0);
+    if(quantized)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(offset));
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(offset + frame));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(offset + uv));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride, (void*)(offset + frame + 2 * sizeof(short)));
+    glDisableVertexAttribArray(4);
+}
+
+// appends indices to out, as 16 bit values when narrow. returns the index type for glDrawElements.
+inline GLenum packIndices(const std::vector<unsigned int> &indices, bool narrow, std::vector<unsigned char> &out)
+{
+    size_t start = out.size();
+    GLenum type = narrow ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    if(indices.empty())
+        return type;
+    if(narrow)
+    {
+        out.resize(start + indices.size() * sizeof(unsigned short));
+        unsigned short *dst = (unsigned short*)&out[start];
+        for(size_t i = 0; i < indices.size(); i++)
+            dst[i] = (unsigned short)indices[i];
+        return GL_UNSIGNED_SHORT;
+    }
+    out.resize(start + indices.size() * sizeof(unsigned int));
+    memcpy(&out[start], &indices[0], indices.size() * sizeof(unsigned int));
+    return GL_UNSIGNED_INT;
+}
+
+inline size_t indexSize(GLenum type)
+{
+    return type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+struct DrawData {
+    mat4 model;
+    uint material;
+    float fade;
+    uint padding[2];
+};
+
+struct Bounds {
+    vec4 lower;
+    vec4 upper;
+};
+
+layout (std430, binding = 0) readonly buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 1) readonly buffer Draws { DrawData draws[]; };
+layout (std430, binding = 2) readonly buffer Boxes { Bounds bounds[]; };
+layout (std430, binding = 3) writeonly buffer Culled { DrawCommand culled[]; };
+layout (std430, binding = 4) buffer Counter { uint visibleCount; };
+layout (std430, binding = 5) buffer Retest { uint retest[]; };
+
+uniform vec4 planes[6];
+uniform int drawCount;
+uniform float margin;
+
+// pass 0 tests the frustum and, with occlusion set, the depth pyramid of the last frame. the draws it finds
+// hidden are flagged in retest, pass 1 tests those again against the pyramid of this frame.
+uniform int pass;
+uniform bool occlusion;
+uniform sampler2D depthPyramid;
+uniform mat4 occluderViewProjection;
+uniform vec2 pyramidSize;
+uniform int pyramidLevels;
+
+// true when the box lies behind the depth in the pyramid everywhere it covers
+bool occluded(vec3 center, vec3 extent) {
+    vec2 lower = vec2(1.0), upper = vec2(0.0);
+    float nearest = 1.0;
+    for (int c = 0; c < 8; c++) {
+        vec3 corner = center + extent * vec3((c & 1) != 0 ? 1.0 : -1.0, (c & 2) != 0 ? 1.0 : -1.0, (c & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = occluderViewProjection * vec4(corner, 1.0);
+        // reaches behind the camera, the rectangle would be unbounded
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        lower = min(lower, ndc.xy * 0.5 + 0.5);
+        upper = max(upper, ndc.xy * 0.5 + 0.5);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    lower = clamp(lower, 0.0, 1.0);
+    upper = clamp(upper, 0.0, 1.0);
+
+    // the level where the rectangle is at most one texel wide, so it touches two by two texels at most
+    vec2 pixels = (upper - lower) * pyramidSize;
+    int level = clamp(int(ceil(log2(max(max(pixels.x, pixels.y), 1.0)))), 0, pyramidLevels - 1);
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 first = clamp(ivec2(lower * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 last = clamp(ivec2(upper * vec2(levelSize)), ivec2(0), levelSize - 1);
+    float farthest = max(max(texelFetch(depthPyramid, first, level).r, texelFetch(depthPyramid, ivec2(last.x, first.y), level).r),
+                         max(texelFetch(depthPyramid, ivec2(first.x, last.y), level).r, texelFetch(depthPyramid, last, level).r));
+    return nearest > farthest;
+}
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uint(drawCount))
+        return;
+    if (pass == 1 && retest[i] == 0u)
+        return;
+
+    // world space box of the record (Arvo), grown by margin
+    mat4 model = draws[i].model;
+    vec3 center = (bounds[i].lower.xyz + bounds[i].upper.xyz) * 0.5;
+    vec3 extent = (bounds[i].upper.xyz - bounds[i].lower.xyz) * 0.5;
+    center = (model * vec4(center, 1.0)).xyz;
+    extent = abs(model[0].xyz) * extent.x + abs(model[1].xyz) * extent.y + abs(model[2].xyz) * extent.z + vec3(margin);
+
+    if (pass == 0) {
+        retest[i] = 0u;
+        for (int p = 0; p < 6; p++) {
+            if (dot(planes[p].xyz, center) + planes[p].w < -dot(abs(planes[p].xyz), extent))
+                return;
+        }
+        if (occlusion && occluded(center, extent)) {
+            retest[i] = 1u;
+            return;
+        }
+    } else if (occluded(center, extent)) {
+        return;
+    }
+    // baseInstance still points at the record, so the survivor keeps its attributes wherever it lands
+    culled[atomicAdd(visibleCount, 1u)] = commands[i];
+}
@@ -0,0 +1,9 @@
+// std140 layout of FrameData in uniform_ring.h, written once per frame by the UniformRing in main.cpp
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec3 cameraPosition;
+    float time;
+    vec2 viewport;
+};
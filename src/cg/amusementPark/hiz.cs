@@ -0,0 +1,27 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform vec2 sourceSize;
+uniform vec2 size;
+
+// farthest depth of the source texels under one destination texel. from the depth copy the footprint is between
+// one and two texels wide and not aligned, further down it is exactly two by two.
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (texel.x >= int(size.x) || texel.y >= int(size.y))
+        return;
+
+    vec2 scale = sourceSize / size;
+    ivec2 first = ivec2(floor(vec2(texel) * scale));
+    ivec2 last = min(ivec2(ceil(vec2(texel + 1) * scale)), ivec2(sourceSize)) - 1;
+    float farthest = 0.0;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++)
+            farthest = max(farthest, texelFetch(source, ivec2(x, y), sourceLevel).r);
+    }
+    imageStore(destination, texel, vec4(farthest));
+}
@@ -0,0 +1,113 @@
+#ifndef ICOSPHERE_H
+#define ICOSPHERE_H
+
+#include "subdivision.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+// indexed icosphere generator.
+// vertices are shared between faces: every edge is stored once and its midpoint is created
+// exactly once, as vertex (vertex count + edge id) of the next level (see subdivision.h).
+// a level n sphere has 10 * 4^n + 2 vertices and 20 * 4^n triangles.
+// since every vertex lies on the sphere, the smooth normal is just normalize(position) and the
+// normal attribute does not need to be stored at all.
+
+inline unsigned int icosphereTriangleCount(int level) {
+    return 20u * (1u << (2 * level));
+}
+
+// builds the 12 vertices and 20 faces of the base icosahedron
+inline void icosahedron(float radius, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices) {
+    const float PI = M_PI;
+    const float H_ANGLE = PI / 180 * 72;
+    const float V_ANGLE = atanf(1.0f / 2);
+
+    positions.resize(12);
+    float hAngle1 = -PI / 2 - H_ANGLE / 2;
+    float hAngle2 = -PI / 2;
+    float z = radius * sinf(V_ANGLE);
+    float xy = radius * cosf(V_ANGLE);
+
+    positions[0] = glm::vec3(0.0f, 0.0f, radius);  // north pole
+    for (int i = 1; i <= 5; ++i) {
+        positions[i] = glm::vec3(xy * cosf(hAngle1), xy * sinf(hAngle1), z);
+        positions[i + 5] = glm::vec3(xy * cosf(hAngle2), xy * sinf(hAngle2), -z);
+        hAngle1 += H_ANGLE;
+        hAngle2 += H_ANGLE;
+    }
+    positions[11] = glm::vec3(0.0f, 0.0f, -radius);  // south pole
+
+    indices.clear();
+    for (unsigned int i = 1; i <= 5; ++i) {
+        unsigned int v1 = i;
+        unsigned int v3 = i + 5;
+        unsigned int v2 = i < 5 ? i + 1 : 1;
+        unsigned int v4 = i < 5 ? i + 5 + 1 : 6;
+
+        unsigned int faces[] = {
+            0, v1, v2,    // v0 -> v1 -> v2
+            v1, v3, v2,   // v1 -> v3 -> v2
+            v2, v3, v4,   // v2 -> v3 -> v4
+            v3, 11, v4};  // v3 -> v11 -> v4
+        indices.insert(indices.end(), faces, faces + 12);
+    }
+}
+
+// draw ranges of one level inside the index buffer built by icospherePyramid()
+struct IcosphereLevel {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    unsigned int vertexCount;
+};
+
+// builds every level from 0 to maxLevel at once.
+// positions holds the vertices of maxLevel (a superset of every coarser level) and indices holds
+// the triangle lists of all levels one after the other, addressed through levels.
+inline void icospherePyramid(int maxLevel, float radius, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices,
+                             std::vector<IcosphereLevel>& levels) {
+    SubdivisionMesh mesh;
+    std::vector<unsigned int> triangles;
+    icosahedron(radius, positions, triangles);
+    subdivisionMesh(positions, triangles, mesh);
+
+    std::size_t total = 0;
+    for (int i = 0; i <= maxLevel; ++i)
+        total += icosphereTriangleCount(i) * 3;
+    indices.clear();
+    indices.reserve(total);
+    levels.clear();
+
+    for (int i = 0; i <= maxLevel; ++i) {
+        if (i > 0)
+            subdivide(mesh, radius);
+
+        IcosphereLevel level;
+        level.firstIndex = indices.size();
+        level.indexCount = mesh.faces.size();
+        indices.insert(indices.end(), mesh.faces.begin(), mesh.faces.end());
+        level.vertexCount = mesh.vertexCount();
+        levels.push_back(level);
+    }
+    subdivisionPositions(mesh, positions);
+}
+
+// picks the coarsest level whose edges still project to at most maxEdgePixels on screen.
+// distance is measured from the eye to the sphere center, fovy is in radians.
+inline int icosphereScreenLevel(float radius, float distance, float fovy, float screenHeight, float maxEdgePixels, int maxLevel) {
+    if (distance <= radius)
+        return maxLevel;
+    // the base icosahedron edge is about 1.05 * radius long and halves with every level
+    float pixelsPerUnit = screenHeight / (2.0f * tanf(fovy / 2.0f) * distance);
+    float edgePixels = 1.05f * radius * pixelsPerUnit;
+    int level = 0;
+    while (level < maxLevel && edgePixels > maxEdgePixels) {
+        edgePixels /= 2.0f;
+        ++level;
+    }
+    return level;
+}
+
+#endif
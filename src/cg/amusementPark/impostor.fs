@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D atlas;
+
+// the atlas is cleared to transparent around the captured model
+void main() {
+    vec4 color = texture(atlas, TexCoords);
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb / color.a, 1.0);
+}
@@ -0,0 +1,51 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec4 aPositionScale;
+layout (location = 2) in float aYaw;
+
+out vec2 TexCoords;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 cameraPosition;
+uniform vec3 center;    // bounding sphere of the captured model
+uniform float radius;
+uniform int frames;     // frames per side of the atlas
+
+// same mapping as octahedronDirection() in impostor.h
+vec3 octahedronDirection(vec2 uv) {
+    vec3 v = vec3(uv.x, 1.0 - abs(uv.x) - abs(uv.y), uv.y);
+    if (v.y < 0.0)
+        v.xz = (1.0 - abs(v.zx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.z >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+vec2 octahedronPoint(vec3 direction) {
+    vec3 p = direction / (abs(direction.x) + abs(direction.y) + abs(direction.z));
+    vec2 uv = p.xz;
+    if (p.y < 0.0)
+        uv = (1.0 - abs(uv.yx)) * vec2(uv.x >= 0.0 ? 1.0 : -1.0, uv.y >= 0.0 ? 1.0 : -1.0);
+    return uv;
+}
+
+void main() {
+    float scale = aPositionScale.w;
+    mat3 turn = mat3(cos(aYaw), 0.0, -sin(aYaw),
+                     0.0, 1.0, 0.0,
+                     sin(aYaw), 0.0, cos(aYaw));
+    vec3 worldCenter = aPositionScale.xyz + turn * (center * scale);
+
+    // the captured frame closest to the direction the copy is seen from, in its own space
+    vec3 toCamera = transpose(turn) * (cameraPosition - worldCenter);
+    vec2 grid = round((octahedronPoint(normalize(toCamera)) * 0.5 + 0.5) * float(frames - 1));
+    vec3 direction = octahedronDirection(grid / float(frames - 1) * 2.0 - 1.0);
+
+    // the quad takes the orientation of that frame's camera (glm::lookAt), so the image lines up with the model
+    vec3 up = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(-direction, up));
+    up = cross(right, -direction);
+    vec3 offset = turn * (right * aCorner.x + up * aCorner.y) * radius * scale;
+
+    TexCoords = (grid + aCorner * 0.5 + 0.5) / float(frames);
+    gl_Position = projection * view * vec4(worldCenter + offset, 1.0);
+}
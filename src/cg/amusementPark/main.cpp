@@ -1,15 +1,28 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
+#include <learnopengl/bvh.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/filesystem.h>
+#include <learnopengl/hiz_buffer.h>
+#include <learnopengl/impostor.h>
 #include <learnopengl/model.h>
-#include <learnopengl/shader_m.h>
+#include <learnopengl/model_batch.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/texture_manager.h>
+#include <learnopengl/uniform_ring.h>
 #include <stb_image.h>
 
+#include "icosphere.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -18,16 +31,16 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 unsigned int loadTexture(const char* path);
 unsigned int loadCubemap(std::vector<std::string> faces);
-void sphereSubdivision(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& line);
-void computeFaceNormal(glm::vec3* v0, glm::vec3* v1, glm::vec3* v2, glm::vec3& normal);
-void computeHalfVertex(glm::vec3 v1, glm::vec3 v2, glm::vec3& v);
-void addVertices(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, std::vector<glm::vec3>& v);
-void addNormals(glm::vec3 n1, glm::vec3 n2, glm::vec3 n3, std::vector<glm::vec3>& normals);
-void addLines(glm::vec3 v1, glm::vec3 v2, std::vector<glm::vec3>& lines);
+void buildSphere();
 void initSphere();
+int sphereLevel(const glm::vec3& center);
+void initTorus(int slices, int rings);
+unsigned int addSceneObject(int kind, unsigned int index, const AABB& bounds);
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// kept current by framebuffer_size_callback, differs from the window size on high dpi screens
+int framebufferWidth = SCR_WIDTH, framebufferHeight = SCR_HEIGHT;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = (float)SCR_WIDTH / 2.0;
@@ -37,14 +50,75 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-bool init = true;
-unsigned int sphereLineVAO, sphereLineVBO;
-unsigned int sphereVAO, sphereVBO;
+const int SPHERE_MAX_LEVEL = 5;
+const float SPHERE_MAX_EDGE_PIXELS = 12.0f;
+
+bool sphereReady = false;
+unsigned int sphereVAO, sphereVBO, sphereEBO;
 float sphereRadius = 1.0f;
-int sphereSubdivisionLevel = 5;
+int sphereSubdivisionLevel = -1;  // -1 picks the level from the projected size, 1 ~ 5 override it
 
 std::vector<glm::vec3> sphereVertices;
-std::vector<glm::vec3> sphereLines;
+std::vector<unsigned int> sphereIndices;
+std::vector<IcosphereLevel> sphereLevels;
+
+// wireframe is drawn in the same pass as the surface, see sphere.gs
+struct SphereInstance {
+    glm::vec3 center;
+    bool wireframe;
+    unsigned int object;  // in sceneObjects
+};
+std::vector<SphereInstance> sphereInstances;
+const float WIRE_WIDTH = 0.5f;
+
+// hardware tessellation path (GL 4.0): only the base patches live on the GPU
+const float TESS_EDGE_PIXELS = 12.0f;
+bool tessellationSupported = false;
+bool sphereTessellation = false;
+unsigned int torusVAO, torusVBO;
+unsigned int torusPatchVertices = 0;
+
+// the model batch picks a level of detail per model, switches are dithered over a short fade unless disabled
+bool modelCrossFade = true;
+// on GL 4.3 the batch culls its own draws in a compute shader, otherwise they go through the BVH like the rest
+bool gpuCulling = false;
+// hides the statue's meshes behind other geometry: the depth pyramid on the gpu path, occlusion queries otherwise
+bool occlusionCulling = true;
+
+// a crowd of statues behind the park. the ones farther than IMPOSTOR_DISTANCE are drawn as octahedral impostors,
+// one quad each, the closer ones as instanced meshes. with impostors off every statue is a mesh
+const int CROWD_COLUMNS = 50;
+const int CROWD_ROWS = 40;
+const float CROWD_SPACING = 2.0f;
+const float CROWD_SCALE = 0.15f;
+const float IMPOSTOR_DISTANCE = 20.0f;
+const int IMPOSTOR_FRAMES = 12;
+const int IMPOSTOR_FRAME_SIZE = 128;
+bool impostors = true;
+std::vector<ImpostorInstance> crowd;
+
+// everything that can be culled. the BVH holds a box per object and hands back indices into sceneObjects
+enum SceneObjectKind { OBJECT_FLOOR, OBJECT_SPHERE, OBJECT_TORUS, OBJECT_MODEL_MESH };
+struct SceneObject {
+    int kind;
+    unsigned int index;  // sphere instance or mesh of the model batch
+    int leaf;
+    bool visible;
+};
+std::vector<SceneObject> sceneObjects;
+BVH sceneBVH;
+// std140 layout of the Object block of floor.vs and the sphere and torus shaders, bound per draw from the UniformRing
+struct ObjectData {
+    glm::mat4 model;
+    int wireframe;      // a bool takes four bytes in std140
+    int padding[3];
+};
+
+// the explosion pushes triangles up to this far along their normal in world units, see man_batch.vs.
+// turning it off switches the statue to the variant of its shader compiled without SHADER_EXPLODE and to the
+// indexed copy of its meshes, the face normal copy is only drawn while it explodes
+const float EXPLODE_MARGIN = 2.0f;
+bool explode = true;
 
 int main() {
     glfwInit();
@@ -62,6 +136,7 @@ int main() {
 
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     // glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -74,10 +149,47 @@ int main() {
     glEnable(GL_DEPTH_TEST);
 
     Shader floorShader("floor.vs", "floor.fs");
-    Shader sphereShader("sphere.vs", "sphere.fs");
-    Shader manShader("man.vs", "man.fs", "man.gs");
+    Shader sphereShader("sphere.vs", "sphere.fs", "sphere.gs");
+    ShaderVariants manShaders("man_batch.vs", "man_batch.fs");
     Shader skyboxShader("skybox.vs", "skybox.fs");
 
+    // camera data goes out once per frame and model matrices once per draw, into one buffer all programs read
+    std::unique_ptr<UniformRing> uniformRing(new UniformRing());
+    UniformRing::attach(floorShader);
+    UniformRing::attach(sphereShader);
+    manShaders.setSetup(UniformRing::attach);
+    UniformRing::attach(skyboxShader);
+
+    std::unique_ptr<Shader> sphereTessShader, torusShader;
+    tessellationSupported = GLAD_GL_VERSION_4_0;
+    if (tessellationSupported) {
+        sphereTessShader.reset(new Shader("patch.vs", "sphere.fs", "sphere.gs", "sphere.tcs", "sphere.tes"));
+        torusShader.reset(new Shader("patch.vs", "sphere.fs", "sphere.gs", "torus.tcs", "torus.tes"));
+        UniformRing::attach(*sphereTessShader);
+        UniformRing::attach(*torusShader);
+        initTorus(8, 4);
+    }
+
+    std::unique_ptr<Shader> cullShader, hizShader;
+    std::unique_ptr<HiZBuffer> hiZ;
+    if (GLAD_GL_VERSION_4_3) {
+        cullShader.reset(new Shader("cull.cs"));
+        hizShader.reset(new Shader("hiz.cs"));
+        hiZ.reset(new HiZBuffer());
+        gpuCulling = true;
+    }
+    Shader occlusionBoxShader("occlusion_box.vs", "occlusion_box.fs");
+
+    // every sphere level is generated on a worker thread while the textures and models load
+    std::future<void> sphereBuild = std::async(std::launch::async, buildSphere);
+    SphereInstance sphere = {glm::vec3(-5.0, 1.0, -5.0), true, 0};
+    sphere.object = addSceneObject(OBJECT_SPHERE, sphereInstances.size(), AABB(sphere.center - glm::vec3(sphereRadius), sphere.center + glm::vec3(sphereRadius)));
+    sphereInstances.push_back(sphere);
+    unsigned int floorObject = addSceneObject(OBJECT_FLOOR, 0, AABB(glm::vec3(-5.0, -0.5, -5.0), glm::vec3(5.0, -0.5, 5.0)));
+    const glm::vec3 torusCenter(5.0, 1.0, -5.0);
+    const glm::vec3 torusExtent(1.3, 0.3, 1.3);  // major radius 1 and minor radius 0.3, lying in the xz plane
+    unsigned int torusObject = tessellationSupported ? addSceneObject(OBJECT_TORUS, 0, AABB(torusCenter - torusExtent, torusCenter + torusExtent)) : 0;
+
     float planeVertices[] = {
         // positions          // texture Coords
         5.0f, -0.5f, 5.0f, 2.0f, 0.0f,
@@ -166,9 +278,36 @@ int main() {
 
     unsigned int floorTexture = loadTexture(FileSystem::getPath("resources/textures/wood.png").c_str());
 
-    Model man(FileSystem::getPath("resources/objects/nanosuit/nanosuit.obj"));
+    // held by pointer so it gives its textures back while the context still exists.
+    // it is imported on a worker thread, the loop uploads it piece by piece and draws what has arrived so far.
+    // it only feeds the batch, which has texture arrays of its own, and is deleted once complete
+    std::unique_ptr<Model> man(new Model(FileSystem::getPath("resources/objects/nanosuit/nanosuit.obj"), false, VERTEX_PACKED, true));
+    man->loadTextures = false;
+
+    // the crowd and the impostor capture draw instances of the statue out of the batch
+    Shader& crowdShader = manShaders.get(SHADER_INSTANCED);
+    Shader impostorShader("impostor.vs", "impostor.fs");
+    std::unique_ptr<Impostor> manImpostor;
+    for (int row = 0; row < CROWD_ROWS; ++row) {
+        for (int column = 0; column < CROWD_COLUMNS; ++column) {
+            ImpostorInstance statue;
+            statue.position = glm::vec3((column - CROWD_COLUMNS / 2) * CROWD_SPACING, -0.5f, -15.0f - row * CROWD_SPACING);
+            statue.scale = CROWD_SCALE;
+            statue.yaw = glm::radians((float)(std::rand() % 360));
+            crowd.push_back(statue);
+        }
+    }
+    std::vector<glm::mat4> nearStatues;
+    std::vector<ImpostorInstance> farStatues;
 
-    initSphere();
+    // every mesh of the models goes out in one multi draw, see model_batch.h. filled while the model loads
+    std::unique_ptr<ModelBatch> models;
+    bool manLoaded = false;
+    unsigned int manHandle = 0;
+    std::vector<unsigned int> manObjects;  // scene object of every mesh, their boxes follow the model matrix
+
+    std::vector<unsigned int> visibleObjects;
+    CullStats shownStats = {0, 0, 0, 0};
 
     // todo
     std::vector<glm::vec3> path;
@@ -187,6 +326,37 @@ int main() {
 
         processInput(window);
 
+        // textures and models stream in while the scene is already on screen. the batch takes every mesh of the
+        // statue in the frame it arrives, then fills its texture arrays and captures the impostor a few pieces a frame
+        TextureManager::get().uploadReady();
+        if (!manLoaded) {
+            manLoaded = man->update();
+            if (!models) {
+                models.reset(new ModelBatch(VERTEX_PACKED_QUANTIZED));
+                models->faceNormals = true;
+                manHandle = models->add(*man);
+            } else {
+                models->append(manHandle, *man);
+            }
+            for (int i = manObjects.size(); i < models->meshCount(manHandle); ++i)
+                manObjects.push_back(addSceneObject(OBJECT_MODEL_MESH, i, models->meshBounds(manHandle, i)));
+            if (manLoaded) {
+                models->finish();
+                std::cout << "model batch: " << models->meshCount(manHandle) << " meshes" << (GLAD_GL_VERSION_4_3 ? "" : " (no GL 4.3, drawing one by one)") << std::endl;
+                // everything is drawn from the batch's own copy, so the model goes with its cpu and gpu memory
+                std::cout << "geometry: model " << man->cpuBytes() / 1024 << " KB cpu, " << man->gpuBytes() / 1024 << " KB gpu freed, batch "
+                          << models->gpuBytes() / 1024 << " KB gpu" << std::endl;
+                man.reset();
+            }
+        }
+        if (manLoaded && models->uploadMaterials() && !manImpostor) {
+            std::cout << "textures: " << TextureManager::get().textureCount() << ", " << TextureManager::get().residentBytes() / (1024 * 1024) << " MB resident, batch "
+                      << models->layerCount() << " layers in " << models->arrayCount() << " arrays, " << models->textureGpuBytes() / (1024 * 1024) << " MB" << std::endl;
+            // captured one row of frames per frame, see below
+            manImpostor.reset(new Impostor(IMPOSTOR_FRAMES, IMPOSTOR_FRAME_SIZE));
+            manImpostor->beginCapture(models->modelBounds(manHandle));
+        }
+
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -194,45 +364,181 @@ int main() {
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 
-        floorShader.use();
-        floorShader.setMat4("view", view);
-        floorShader.setMat4("projection", projection);
-        floorShader.setMat4("model", glm::mat4(1.0f));
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        manShader.use();
-        manShader.setMat4("view", view);
-        manShader.setMat4("projection", projection);
-        model = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(0.0, 1.0, -10.0));
+        uniformRing->beginFrame();
+        FrameData frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+        frame.cameraPosition = camera.Position;
+        frame.time = currentFrame;
+        frame.viewport = glm::vec2(framebufferWidth, framebufferHeight);
+        uniformRing->bind(FRAME_BLOCK_BINDING, frame);
+
+        if (manImpostor && !manImpostor->captured()) {
+            // a single statue at the origin, with a Frame block per capture camera
+            models->setInstances(std::vector<glm::mat4>(1, glm::mat4(1.0f)));
+            crowdShader.use();
+            bool captured = manImpostor->captureFrames([&](const glm::mat4& captureView, const glm::mat4& captureProjection) {
+                FrameData capture = frame;
+                capture.view = captureView;
+                capture.projection = captureProjection;
+                capture.viewProjection = captureProjection * captureView;
+                uniformRing->bind(FRAME_BLOCK_BINDING, capture);
+                models->DrawInstanced(crowdShader, manHandle);
+            }, IMPOSTOR_FRAMES);
+            uniformRing->bind(FRAME_BLOCK_BINDING, frame);
+            if (captured)
+                std::cout << "impostor: " << manImpostor->frameCount() << " frames, " << manImpostor->gpuBytes() / 1024 << " KB atlas" << std::endl;
+        }
+        ObjectData object = {glm::mat4(1.0f), 0, {0, 0, 0}};
+
+        glm::mat4 manModel = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(0.0, 1.0, -10.0));
         std::cout << "yaw: " << camera.Yaw << std::endl;
         std::cout << "pitch: " << camera.Pitch << std::endl;
-        model = glm::rotate(model, glm::radians(-camera.Yaw - 90.0f), glm::vec3(0.0, 1.0, 0.0));
-        model = glm::rotate(model, glm::radians(camera.Pitch), glm::vec3(1.0, 0.0, 0.0));
-        manShader.setMat4("model", model);
-        manShader.setVec3("color", glm::vec3(204 / 255.0f, 153 / 255.0f, 0.0f));
-        manShader.setFloat("time", glfwGetTime());
-        man.Draw(manShader);
-
-        model = glm::translate(glm::mat4(1.0f), glm::vec3(-5.0, 1.0, -5.0));
-        sphereShader.use();
-        sphereShader.setMat4("view", view);
-        sphereShader.setMat4("projection", projection);
-        sphereShader.setMat4("model", model);
-        sphereShader.setVec3("color", glm::vec3(1.0, 0.0, 0.0));
-        glBindVertexArray(sphereVAO);
-        glDrawArrays(GL_TRIANGLES, 0, sphereVertices.size());
-
-        sphereShader.setVec3("color", glm::vec3(0.0, 0.0, 0.0));
-        glBindVertexArray(sphereLineVAO);
-        glDrawArrays(GL_LINES, 0, sphereLines.size());
+        manModel = glm::rotate(manModel, glm::radians(-camera.Yaw - 90.0f), glm::vec3(0.0, 1.0, 0.0));
+        manModel = glm::rotate(manModel, glm::radians(camera.Pitch), glm::vec3(1.0, 0.0, 0.0));
+
+        float explodeMargin = explode ? EXPLODE_MARGIN : 0.0f;
+        // frustum culling before anything is submitted. the statue turns with the camera, so its boxes move every frame
+        for (std::size_t i = 0; i < manObjects.size(); ++i)
+            sceneBVH.update(sceneObjects[manObjects[i]].leaf, models->meshBounds(manHandle, i).transformed(manModel).expanded(explodeMargin));
+        visibleObjects.clear();
+        CullStats cullStats = sceneBVH.cull(Frustum(projection * view), visibleObjects);
+        for (std::size_t i = 0; i < sceneObjects.size(); ++i)
+            sceneObjects[i].visible = false;
+        for (std::size_t i = 0; i < visibleObjects.size(); ++i)
+            sceneObjects[visibleObjects[i]].visible = true;
+        for (std::size_t i = 0; i < manObjects.size(); ++i)
+            models->setMeshVisible(manHandle, i, gpuCulling || sceneObjects[manObjects[i]].visible);
+        if (cullStats.visible != shownStats.visible || cullStats.culled != shownStats.culled) {
+            std::string title = "P5 Amusement Park - " + std::to_string(cullStats.visible) + " visible, " + std::to_string(cullStats.culled) + " culled";
+            glfwSetWindowTitle(window, title.c_str());
+            shownStats = cullStats;
+        }
+
+        if (sceneObjects[floorObject].visible) {
+            floorShader.use();
+            object.model = glm::mat4(1.0f);
+            object.wireframe = false;
+            uniformRing->bind(OBJECT_BLOCK_BINDING, object);
+            glBindVertexArray(planeVAO);
+            glBindTexture(GL_TEXTURE_2D, floorTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+
+        if (!sphereReady && sphereBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            initSphere();
+
+        if (sphereReady && sphereTessellation) {
+            // the 20 faces of level 0 are the base patches, the tessellator does the rest
+            const IcosphereLevel& base = sphereLevels[0];
+            sphereTessShader->use();
+            sphereTessShader->setFloat("edgePixels", TESS_EDGE_PIXELS);
+            sphereTessShader->setFloat("radius", sphereRadius);
+            sphereTessShader->setVec3("color", glm::vec3(1.0, 0.0, 0.0));
+            sphereTessShader->setVec3("wireColor", glm::vec3(0.0, 0.0, 0.0));
+            sphereTessShader->setFloat("wireWidth", WIRE_WIDTH);
+            glBindVertexArray(sphereVAO);
+            glPatchParameteri(GL_PATCH_VERTICES, 3);
+            for (std::size_t i = 0; i < sphereInstances.size(); ++i) {
+                if (!sceneObjects[sphereInstances[i].object].visible)
+                    continue;
+                object.model = glm::translate(glm::mat4(1.0f), sphereInstances[i].center);
+                object.wireframe = sphereInstances[i].wireframe;
+                uniformRing->bind(OBJECT_BLOCK_BINDING, object);
+                glDrawElements(GL_PATCHES, base.indexCount, GL_UNSIGNED_INT, (void*)(base.firstIndex * sizeof(unsigned int)));
+            }
+        } else if (sphereReady) {
+            sphereShader.use();
+            sphereShader.setVec3("color", glm::vec3(1.0, 0.0, 0.0));
+            sphereShader.setVec3("wireColor", glm::vec3(0.0, 0.0, 0.0));
+            sphereShader.setFloat("wireWidth", WIRE_WIDTH);
+            glBindVertexArray(sphereVAO);
+            for (std::size_t i = 0; i < sphereInstances.size(); ++i) {
+                if (!sceneObjects[sphereInstances[i].object].visible)
+                    continue;
+                const IcosphereLevel& level = sphereLevels[sphereLevel(sphereInstances[i].center)];
+                object.model = glm::translate(glm::mat4(1.0f), sphereInstances[i].center);
+                object.wireframe = sphereInstances[i].wireframe;
+                uniformRing->bind(OBJECT_BLOCK_BINDING, object);
+                glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void*)(level.firstIndex * sizeof(unsigned int)));
+            }
+        }
+
+        if (tessellationSupported && sceneObjects[torusObject].visible) {
+            torusShader->use();
+            object.model = glm::translate(glm::mat4(1.0f), torusCenter);
+            object.wireframe = false;
+            uniformRing->bind(OBJECT_BLOCK_BINDING, object);
+            torusShader->setFloat("edgePixels", TESS_EDGE_PIXELS);
+            torusShader->setFloat("majorRadius", 1.0f);
+            torusShader->setFloat("minorRadius", 0.3f);
+            torusShader->setVec3("color", glm::vec3(0.0, 0.4, 1.0));
+            glBindVertexArray(torusVAO);
+            glPatchParameteri(GL_PATCH_VERTICES, 4);
+            glDrawArrays(GL_PATCHES, 0, torusPatchVertices);
+        }
+
+        if (manImpostor) {
+            nearStatues.clear();
+            farStatues.clear();
+            for (std::size_t i = 0; i < crowd.size(); ++i) {
+                if (impostors && glm::distance(crowd[i].position, camera.Position) > IMPOSTOR_DISTANCE) {
+                    farStatues.push_back(crowd[i]);
+                    continue;
+                }
+                glm::mat4 statue = glm::translate(glm::mat4(1.0f), crowd[i].position);
+                statue = glm::rotate(statue, crowd[i].yaw, glm::vec3(0.0, 1.0, 0.0));
+                nearStatues.push_back(glm::scale(statue, glm::vec3(crowd[i].scale)));
+            }
+            models->setInstances(nearStatues);
+            crowdShader.use();
+            models->DrawInstanced(crowdShader, manHandle);
+            manImpostor->setInstances(farStatues);
+            manImpostor->Draw(impostorShader, view, projection, camera.Position);
+        }
+
+        model = manModel;
+        if (models->meshCount(manHandle) > 0) {
+            models->setTransform(manHandle, model);
+            models->crossFade = modelCrossFade;
+            models->selectLod(manHandle, camera.Position, glm::radians(camera.Zoom), (float)framebufferHeight);
+            models->update(deltaTime);
+            models->drawFaceNormals(explode);
+            // same margin as the boxes in the BVH, the explosion moves triangles outside their mesh's box.
+            // the statue goes last, the floor, the spheres and the torus are its occluders
+            bool occlusionPass = gpuCulling && occlusionCulling;
+            if (gpuCulling)
+                models->cullOnGpu(*cullShader, projection * view, explodeMargin, occlusionPass ? hiZ.get() : NULL);
+            else if (occlusionCulling)
+                models->queryOcclusion(occlusionBoxShader, projection * view, camera.Position, explodeMargin);
+            Shader& manShader = manShaders.get(explode ? SHADER_EXPLODE : 0);
+            manShader.use();
+            manShader.setFloat("magnitude", EXPLODE_MARGIN);
+            models->Draw(manShader);
+            if (occlusionPass) {
+                // next frame culls against this depth, and what this frame's first pass held back gets a second look
+                hiZ->build(*hizShader, framebufferWidth, framebufferHeight, projection * view);
+                if (models->retestOnGpu(*cullShader, *hiZ)) {
+                    manShader.use();
+                    models->Draw(manShader);
+                }
+            }
+        } else if (man) {
+            // no mesh has arrived yet: the bounding box of the statue as a wireframe
+            sphereShader.use();
+            sphereShader.setVec3("color", glm::vec3(0.6, 0.6, 0.6));
+            sphereShader.setVec3("wireColor", glm::vec3(0.0, 0.0, 0.0));
+            sphereShader.setFloat("wireWidth", WIRE_WIDTH);
+            object.model = model;
+            object.wireframe = true;
+            uniformRing->bind(OBJECT_BLOCK_BINDING, object);
+            man->Draw(sphereShader);
+        }
+
 
         glDepthFunc(GL_LEQUAL);
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
@@ -240,10 +546,19 @@ int main() {
         glBindVertexArray(0);
         glDepthFunc(GL_LESS);
 
+        uniformRing->endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    models.reset();
+    manImpostor.reset();
+    man.reset();
+    hiZ.reset();
+    uniformRing.reset();
+    TextureManager::get().release(floorTexture);
+    TextureManager::get().release(cubemapTexture);
+
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
 
@@ -251,8 +566,17 @@ int main() {
     return 0;
 }
 
+unsigned int addSceneObject(int kind, unsigned int index, const AABB& bounds) {
+    SceneObject object = {kind, index, 0, true};
+    object.leaf = sceneBVH.insert(bounds, sceneObjects.size());
+    sceneObjects.push_back(object);
+    return sceneObjects.size() - 1;
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 // not used
@@ -311,309 +635,125 @@ void processInput(GLFWwindow* window) {
 
     camera.ProcessMouseMovement(xoffset, yoffset);
 
-    bool subdivisionLevelChanged = false;
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS && sphereSubdivisionLevel != 1) {
+    // the subdivision level only overrides the automatic choice, switching is just another draw range
+    if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS)
+        sphereSubdivisionLevel = -1;
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
         sphereSubdivisionLevel = 1;
-        subdivisionLevelChanged = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS && sphereSubdivisionLevel != 2) {
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
         sphereSubdivisionLevel = 2;
-        subdivisionLevelChanged = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS && sphereSubdivisionLevel != 3) {
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
         sphereSubdivisionLevel = 3;
-        subdivisionLevelChanged = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS && sphereSubdivisionLevel != 4) {
+    if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
         sphereSubdivisionLevel = 4;
-        subdivisionLevelChanged = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS && sphereSubdivisionLevel != 5) {
+    if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
         sphereSubdivisionLevel = 5;
-        subdivisionLevelChanged = true;
-    }
 
-    if (subdivisionLevelChanged) {
-        // std::cout << "subdivision level changed" << std::endl;
-        initSphere();
-    }
+    // toggle on release so holding the key does not flicker between the two paths
+    static bool tessellationKey = false;
+    bool tessellationKeyDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (tessellationSupported && tessellationKey && !tessellationKeyDown)
+        sphereTessellation = !sphereTessellation;
+    tessellationKey = tessellationKeyDown;
+
+    static bool crossFadeKey = false;
+    bool crossFadeKeyDown = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (crossFadeKey && !crossFadeKeyDown)
+        modelCrossFade = !modelCrossFade;
+    crossFadeKey = crossFadeKeyDown;
+
+    static bool cullingKey = false;
+    bool cullingKeyDown = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (GLAD_GL_VERSION_4_3 && cullingKey && !cullingKeyDown)
+        gpuCulling = !gpuCulling;
+    cullingKey = cullingKeyDown;
+
+    static bool occlusionKey = false;
+    bool occlusionKeyDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKey && !occlusionKeyDown)
+        occlusionCulling = !occlusionCulling;
+    occlusionKey = occlusionKeyDown;
+
+    static bool impostorKey = false;
+    bool impostorKeyDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (impostorKey && !impostorKeyDown)
+        impostors = !impostors;
+    impostorKey = impostorKeyDown;
+
+    static bool explodeKey = false;
+    bool explodeKeyDown = glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS;
+    if (explodeKey && !explodeKeyDown)
+        explode = !explode;
+    explodeKey = explodeKeyDown;
 }
 
+// both loaders hand out a reference on the TextureManager, so the floor, the skybox and the models share textures.
+// neither waits for the decode, the render loop uploads each texture once it is ready
 unsigned int loadTexture(char const* path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureManager::get().acquire(path);
 }
 
 unsigned int loadCubemap(std::vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
-
-void sphereSubdivision(std::vector<glm::vec3>& v, std::vector<glm::vec3>& l) {
-    const float PI = M_PI;
-    const float H_ANGLE = PI / 180 * 72;
-    const float V_ANGLE = atanf(1.0f / 2);
-
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-
-    std::vector<glm::vec3> tmpVertices;
-    std::vector<glm::vec3> tmpLines;
-
-    tmpVertices.clear();
-    tmpVertices.resize(12);
-    int i1, i2;
-    float z, xy;
-    float hAngle1 = -PI / 2 - H_ANGLE / 2;
-    float hAngle2 = -PI / 2;
-
-    tmpVertices[0] = glm::vec3(0.0f, 0.0f, sphereRadius);
-
-    for (int i = 1; i <= 5; ++i) {
-        i1 = i;
-        i2 = (i + 5);
-
-        z = sphereRadius * sinf(V_ANGLE);
-        xy = sphereRadius * cosf(V_ANGLE);
-
-        tmpVertices[i1] = glm::vec3(xy * cosf(hAngle1), xy * sinf(hAngle1), z);
-        tmpVertices[i2] = glm::vec3(xy * cosf(hAngle2), xy * sinf(hAngle2), -z);
-
-        hAngle1 += H_ANGLE;
-        hAngle2 += H_ANGLE;
-    }
-
-    i1 = 11;
-    tmpVertices[i1] = glm::vec3(0.0f, 0.0f, -sphereRadius);
-
-    glm::vec3 *v0, *v1, *v2, *v3, *v4, *v11;
-    glm::vec3 normal;
-
-    v0 = &tmpVertices[0];    // north pole
-    v11 = &tmpVertices[11];  // south pole
-    for (int i = 1; i <= 5; ++i) {
-        v1 = &tmpVertices[i];
-        v3 = &tmpVertices[i + 5];
-        if (i < 5) {
-            v2 = &tmpVertices[i + 1];
-            v4 = &tmpVertices[i + 5 + 1];
-        } else {
-            v2 = &tmpVertices[1];
-            v4 = &tmpVertices[6];
-        }
-
-        // v0 -> v1 -> v2 -> v0
-        computeFaceNormal(v0, v1, v2, normal);
-        vertices.push_back(*v0);
-        vertices.push_back(*v1);
-        vertices.push_back(*v2);
-        normals.push_back(normal);
-        normals.push_back(normal);
-        normals.push_back(normal);
-
-        // v1 -> v3 -> v2 -> v1
-        computeFaceNormal(v1, v3, v2, normal);
-        vertices.push_back(*v1);
-        vertices.push_back(*v3);
-        vertices.push_back(*v2);
-        normals.push_back(normal);
-        normals.push_back(normal);
-        normals.push_back(normal);
-
-        // v2 -> v3 -> v4 -> v2
-        computeFaceNormal(v2, v3, v4, normal);
-        vertices.push_back(*v2);
-        vertices.push_back(*v3);
-        vertices.push_back(*v4);
-        normals.push_back(normal);
-        normals.push_back(normal);
-        normals.push_back(normal);
-
-        // v3 -> v11 -> v4 -> v3
-        computeFaceNormal(v3, v11, v4, normal);
-        vertices.push_back(*v3);
-        vertices.push_back(*v11);
-        vertices.push_back(*v4);
-        normals.push_back(normal);
-        normals.push_back(normal);
-        normals.push_back(normal);
-
-        // lines
-        tmpLines.push_back(*v0);
-        tmpLines.push_back(*v1);
-        tmpLines.push_back(*v1);
-        tmpLines.push_back(*v3);
-        tmpLines.push_back(*v1);
-        tmpLines.push_back(*v2);
-        tmpLines.push_back(*v3);
-        tmpLines.push_back(*v2);
-        tmpLines.push_back(*v3);
-        tmpLines.push_back(*v4);
-        tmpLines.push_back(*v3);
-        tmpLines.push_back(*v11);
-    }
-
-    for (int i = 0; i < sphereSubdivisionLevel; ++i) {
-        tmpVertices = vertices;
-        vertices.clear();
-        tmpLines.clear();
-
-        std::size_t count = tmpVertices.size();
-        glm::vec3 v1, v2, v3, new1, new2, new3;
-        for (std::size_t j = 0; j < count; j += 3) {
-            v1 = tmpVertices[j];
-            v2 = tmpVertices[j + 1];
-            v3 = tmpVertices[j + 2];
-
-            computeHalfVertex(v1, v2, new1);
-            computeHalfVertex(v2, v3, new2);
-            computeHalfVertex(v1, v3, new3);
-
-            computeFaceNormal(&v1, &new1, &new3, normal);
-            addVertices(v1, new1, new3, vertices);
-            addNormals(normal, normal, normal, normals);
-
-            computeFaceNormal(&new1, &v2, &new2, normal);
-            addVertices(new1, v2, new2, vertices);
-            addNormals(normal, normal, normal, normals);
-
-            computeFaceNormal(&new1, &new2, &new3, normal);
-            addVertices(new1, new2, new3, vertices);
-            addNormals(normal, normal, normal, normals);
-
-            computeFaceNormal(&new3, &new2, &v3, normal);
-            addVertices(new3, new2, v3, vertices);
-            addNormals(normal, normal, normal, normals);
-
-            addLines(v1, new1, tmpLines);
-            addLines(new1, new3, tmpLines);
-            addLines(new1, new2, tmpLines);
-            addLines(new1, v2, tmpLines);
-            addLines(v2, new2, tmpLines);
-            addLines(new2, v3, tmpLines);
-            addLines(new2, new3, tmpLines);
-        }
-    }
-
-    // build interleaved vertices
-    v.clear();
-    std::size_t count = vertices.size();
-    for (std::size_t i = 0; i < count; ++i) {
-        v.push_back(vertices[i]);
-        v.push_back(normals[i]);
-    }
-
-    l = tmpLines;
-}
-
-void computeFaceNormal(glm::vec3* v0, glm::vec3* v1, glm::vec3* v2, glm::vec3& normal) {
-    normal = glm::vec3(0.0, 0.0, 0.0);
-
-    glm::vec3 e1(*v1 - *v0);
-    glm::vec3 e2(*v2 - *v1);
-
-    normal = glm::cross(e1, e2);
-    normal = glm::normalize(normal);
+    return TextureManager::get().acquireCubemap(faces);
 }
 
-void computeHalfVertex(glm::vec3 v1, glm::vec3 v2, glm::vec3& v) {
-    v = glm::vec3(v1 + v2);
-    v = glm::normalize(v) * sphereRadius;
+// runs on a worker thread, touches no GL state
+void buildSphere() {
+    icospherePyramid(SPHERE_MAX_LEVEL, sphereRadius, sphereVertices, sphereIndices, sphereLevels);
 }
 
-void addVertices(glm::vec3 v1, glm::vec3 v2, glm::vec3 v3, std::vector<glm::vec3>& v) {
-    v.push_back(v1);
-    v.push_back(v2);
-    v.push_back(v3);
-}
+// uploads every level once: one vertex buffer and one index buffer holding all draw ranges
+void initSphere() {
+    glGenVertexArrays(1, &sphereVAO);
+    glGenBuffers(1, &sphereVBO);
+    glGenBuffers(1, &sphereEBO);
 
-void addNormals(glm::vec3 n1, glm::vec3 n2, glm::vec3 n3, std::vector<glm::vec3>& normals) {
-    normals.push_back(n1);
-    normals.push_back(n2);
-    normals.push_back(n3);
+    // positions only, the smooth normal of a sphere vertex is normalize(aPos)
+    glBindVertexArray(sphereVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * sizeof(glm::vec3), &sphereVertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), &sphereIndices[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glBindVertexArray(0);
+
+    // every level is in the buffers now, only the draw ranges are needed
+    std::cout << "sphere: " << (sphereVertices.size() * sizeof(glm::vec3) + sphereIndices.size() * sizeof(unsigned int)) / 1024 << " KB uploaded and released" << std::endl;
+    std::vector<glm::vec3>().swap(sphereVertices);
+    std::vector<unsigned int>().swap(sphereIndices);
+    sphereReady = true;
 }
 
-void addLines(glm::vec3 v1, glm::vec3 v2, std::vector<glm::vec3>& lines) {
-    lines.push_back(v1);
-    lines.push_back(v2);
+int sphereLevel(const glm::vec3& center) {
+    if (sphereSubdivisionLevel >= 0)
+        return sphereSubdivisionLevel;
+    float distance = glm::length(center - camera.Position);
+    return icosphereScreenLevel(sphereRadius, distance, glm::radians(camera.Zoom), (float)framebufferHeight, SPHERE_MAX_EDGE_PIXELS, SPHERE_MAX_LEVEL);
 }
 
-void initSphere() {
-    sphereSubdivision(sphereVertices, sphereLines);
-    // std::cout << "size of glm::vec3: " << sizeof(glm::vec3) << std::endl;
-    // std::cout << "3 * size of float: " << 3 * sizeof(float) << std::endl;
-    // std::cout << "sizeof sphere vertices: " << sphereVertices.size() << std::endl;
-    // for (int i = 0; i < sphereVertices.size(); ++i) {
-    //     std::cout << sphereVertices[i].x << "," << sphereVertices[i].y << "," << sphereVertices[i].z << std::endl;
-    // }
-
-    if (init) {
-        init = false;
-        glGenVertexArrays(1, &sphereVAO);
-        glGenBuffers(1, &sphereVBO);
-        glGenVertexArrays(1, &sphereLineVAO);
-        glGenBuffers(1, &sphereLineVBO);
+// a torus described as a grid of quad patches in (u, v) parameter space.
+// torus.tcs/torus.tes evaluate the surface, so only slices * rings * 4 corners are stored.
+void initTorus(int slices, int rings) {
+    std::vector<glm::vec3> patches;
+    for (int i = 0; i < slices; ++i) {
+        for (int j = 0; j < rings; ++j) {
+            float u0 = (float)i / slices, u1 = (float)(i + 1) / slices;
+            float v0 = (float)j / rings, v1 = (float)(j + 1) / rings;
+            patches.push_back(glm::vec3(u0, v0, 0.0f));
+            patches.push_back(glm::vec3(u1, v0, 0.0f));
+            patches.push_back(glm::vec3(u1, v1, 0.0f));
+            patches.push_back(glm::vec3(u0, v1, 0.0f));
+        }
     }
+    torusPatchVertices = patches.size();
 
-    glBindVertexArray(sphereVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVAO);
-    glBufferData(GL_ARRAY_BUFFER, sphereVertices.size() * (3 * sizeof(float)), &sphereVertices[0], GL_STATIC_DRAW);
+    glGenVertexArrays(1, &torusVAO);
+    glGenBuffers(1, &torusVBO);
+    glBindVertexArray(torusVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, torusVBO);
+    glBufferData(GL_ARRAY_BUFFER, patches.size() * sizeof(glm::vec3), &patches[0], GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * (3 * sizeof(float)), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 2 * (3 * sizeof(float)), (void*)(3 * sizeof(float)));
-
-    glBindVertexArray(sphereLineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, sphereLineVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphereLines.size() * (3 * sizeof(float)), &sphereLines[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (3 * sizeof(float)), (void*)0);
-}
\ No newline at end of file
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glBindVertexArray(0);
+}
@@ -1,10 +0,0 @@
-#version 330 core
-out vec4 FragColor;
-
-in vec2 TexCoords;
-
-uniform sampler2D texture_diffuse1;
-
-void main() {
-    FragColor = texture(texture_diffuse1, TexCoords) + vec4(0.5, 0.5, 0.5, 0.0);
-}
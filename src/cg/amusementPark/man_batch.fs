@@ -0,0 +1,41 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in uint Material;
+// 1 when opaque. while a model switches its level of detail both levels are drawn, the new one with
+// the fade progress f covering that share of the pixels and the old one with -f covering the rest
+flat in float Fade;
+
+// the diffuse textures of the batch in arrays of equal size and format, as many as ModelBatch::MAX_MATERIAL_ARRAYS.
+// Material holds the array in its high 16 bits and the layer in the low ones, all bits set for untextured meshes
+uniform sampler2DArray materials[4];
+
+const float bayer[16] = float[](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+// samplers in an array may only be indexed by constants, so the array is picked by branching
+vec4 diffuse(vec2 uv, uint material) {
+    if (material == 0xFFFFFFFFu)
+        return vec4(1.0);
+    vec3 coordinates = vec3(uv, float(material & 0xFFFFu));
+    uint array = material >> 16;
+    if (array == 0u)
+        return texture(materials[0], coordinates);
+    if (array == 1u)
+        return texture(materials[1], coordinates);
+    if (array == 2u)
+        return texture(materials[2], coordinates);
+    return texture(materials[3], coordinates);
+}
+
+void main() {
+    if (Fade < 1.0) {
+        ivec2 cell = ivec2(gl_FragCoord.xy) % 4;
+        float threshold = (bayer[cell.y * 4 + cell.x] + 0.5) / 16.0;
+        if (Fade >= 0.0 ? threshold >= Fade : threshold < -Fade)
+            discard;
+    }
+    vec4 texel = diffuse(TexCoords, Material);
+    // opaque: the impostor capture reads alpha as coverage
+    FragColor = vec4(texel.rgb + vec3(0.5), 1.0);
+}
@@ -0,0 +1,60 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// the face normal, octahedral, see ModelBatch::faceNormals
+layout (location = 1) in vec2 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// the model matrix of a draw record, or of an instance given to ModelBatch::setInstances()
+layout (location = 5) in mat4 aModel;
+layout (location = 9) in uint aMaterial;
+layout (location = 10) in float aFade;
+
+out vec2 TexCoords;
+flat out uint Material;
+flat out float Fade;
+
+#include "frame.glsl"
+
+#ifdef INSTANCED
+// the records of a multi draw fold the matrix that maps the stored positions back onto the mesh into aModel,
+// the instances of ModelBatch::DrawInstanced get it per mesh
+uniform mat4 positionTransform;
+#endif
+
+#ifdef EXPLODE
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * sign(v.xy);
+    return normalize(v);
+}
+
+// how far the triangles move at most, in world units. EXPLODE_MARGIN in main.cpp, which grows the culling boxes by as much
+uniform float magnitude;
+
+// every triangle moves apart along its normal, up to magnitude in world units. the three vertices of a
+// triangle carry the same normal, so it moves as a whole and no geometry shader has to compute it.
+vec3 explode(vec3 position, vec3 normal) {
+    return position + normal * ((sin(time) + 1.0) / 2.0) * magnitude;
+}
+#endif
+
+void main() {
+    TexCoords = aTexCoords;
+    Material = aMaterial;
+    Fade = aFade;
+#ifdef INSTANCED
+    mat4 model = aModel * positionTransform;
+#else
+    mat4 model = aModel;
+#endif
+    vec4 world = model * vec4(aPos, 1.0);
+#ifdef EXPLODE
+    // normals go through the cofactor matrix, the inverse transpose up to a scale. it also undoes the
+    // non-uniform scale of the quantized positions in the model matrix
+    mat3 m = mat3(model);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    vec3 normal = normalize(cofactor * octDecode(aNormal));
+    world.xyz = explode(world.xyz, normal);
+#endif
+    gl_Position = viewProjection * world;
+}
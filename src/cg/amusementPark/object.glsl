@@ -0,0 +1,5 @@
+// std140 layout of ObjectData in main.cpp, a slice of the UniformRing per draw
+layout (std140) uniform Object {
+    mat4 model;
+    bool wireframe;
+};
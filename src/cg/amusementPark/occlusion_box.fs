@@ -0,0 +1,5 @@
+#version 330 core
+
+// color writes are off, the query only counts samples that pass the depth test
+void main() {
+}
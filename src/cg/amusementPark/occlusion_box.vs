@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 viewProjection;
+uniform vec3 lower;
+uniform vec3 upper;
+
+void main() {
+    gl_Position = viewProjection * vec4(mix(lower, upper, aPos), 1.0);
+}
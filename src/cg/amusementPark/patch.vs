@@ -0,0 +1,9 @@
+#version 400 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 vPos;
+
+void main() {
+    // patches stay in model space, the evaluation shader does the transform
+    vPos = aPos;
+}
@@ -1,8 +1,20 @@
 #version 400 core
 out vec4 FragColor;
 
+noperspective in vec3 EdgeDistance;
+
+#include "object.glsl"
+
 uniform vec3 color;
+uniform vec3 wireColor;
+uniform float wireWidth;
 
 void main() {
-    FragColor = vec4(color, 1.0);
+    vec3 col = color;
+    if (wireframe) {
+        // blend the edge color over one pixel on each side of the line
+        float d = min(EdgeDistance.x, min(EdgeDistance.y, EdgeDistance.z));
+        col = mix(wireColor, color, smoothstep(wireWidth - 1.0, wireWidth + 1.0, d));
+    }
+    FragColor = vec4(col, 1.0);
 }
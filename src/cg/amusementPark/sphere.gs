@@ -0,0 +1,38 @@
+#version 400 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+// distance of the fragment to each edge of its triangle, in pixels
+noperspective out vec3 EdgeDistance;
+
+#include "frame.glsl"
+
+vec2 toScreen(vec4 clip) {
+    return clip.xy / clip.w * 0.5 * viewport;
+}
+
+void main() {
+    vec2 p0 = toScreen(gl_in[0].gl_Position);
+    vec2 p1 = toScreen(gl_in[1].gl_Position);
+    vec2 p2 = toScreen(gl_in[2].gl_Position);
+
+    // height of each vertex over its opposite edge = twice the area / edge length
+    vec2 e0 = p2 - p1;
+    vec2 e1 = p2 - p0;
+    vec2 e2 = p1 - p0;
+    float area = abs(e1.x * e2.y - e1.y * e2.x);
+    float h0 = area / length(e0);
+    float h1 = area / length(e1);
+    float h2 = area / length(e2);
+
+    gl_Position = gl_in[0].gl_Position;
+    EdgeDistance = vec3(h0, 0.0, 0.0);
+    EmitVertex();
+    gl_Position = gl_in[1].gl_Position;
+    EdgeDistance = vec3(0.0, h1, 0.0);
+    EmitVertex();
+    gl_Position = gl_in[2].gl_Position;
+    EdgeDistance = vec3(0.0, 0.0, h2);
+    EmitVertex();
+    EndPrimitive();
+}
@@ -1,11 +1,9 @@
 #version 400 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "frame.glsl"
+#include "object.glsl"
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
 }
@@ -0,0 +1,232 @@
+#ifndef SUBDIVISION_H
+#define SUBDIVISION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// midpoint subdivision kernel for triangle meshes whose vertices lie on a sphere.
+// positions are kept in structure-of-arrays form so the midpoints can be normalized 4 (SSE) or
+// 8 (AVX) at a time. every edge is stored exactly once and the midpoint of edge e becomes vertex
+// vertexCount + e, so the next level's vertex, edge and face counts are known up front:
+//   V' = V + E, E' = 2E + 3F, F' = 4F
+// which lets every level be written into preallocated arrays by independent worker threads.
+struct SubdivisionMesh {
+    std::vector<float> x, y, z;
+    std::vector<unsigned int> edges;      // 2 vertex indices per edge
+    std::vector<unsigned int> faces;      // 3 vertex indices per face
+    std::vector<unsigned int> faceEdges;  // per face: edge ids of side 0 -> 1, 1 -> 2 and 0 -> 2
+
+    std::size_t vertexCount() const { return x.size(); }
+    std::size_t edgeCount() const { return edges.size() / 2; }
+    std::size_t faceCount() const { return faces.size() / 3; }
+};
+
+// runs function(begin, end) over [0, count) split across the hardware threads.
+// ranges smaller than grain items are not worth a thread and run on the caller.
+template <typename Function>
+void parallelFor(std::size_t count, std::size_t grain, Function function) {
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, count / std::max<std::size_t>(grain, 1));
+    if (threads <= 1) {
+        function(std::size_t(0), count);
+        return;
+    }
+
+    // keep chunk boundaries on multiples of 8 so the simd loops only see one tail
+    std::size_t chunk = ((count + threads - 1) / threads + 7) & ~std::size_t(7);
+    std::vector<std::thread> workers;
+    std::size_t begin = 0;
+    for (; begin + chunk < count; begin += chunk)
+        workers.push_back(std::thread(function, begin, begin + chunk));
+    function(begin, count);
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+
+// scales n points onto the sphere of the given radius: o = s / |s| * radius
+inline void subdivisionNormalize(const float* sx, const float* sy, const float* sz,
+                                 float* ox, float* oy, float* oz, std::size_t n, float radius) {
+    std::size_t i = 0;
+#if defined(__AVX__)
+    const __m256 r8 = _mm256_set1_ps(radius);
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(sx + i);
+        __m256 y = _mm256_loadu_ps(sy + i);
+        __m256 z = _mm256_loadu_ps(sz + i);
+        __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+        __m256 scale = _mm256_div_ps(r8, len);
+        _mm256_storeu_ps(ox + i, _mm256_mul_ps(x, scale));
+        _mm256_storeu_ps(oy + i, _mm256_mul_ps(y, scale));
+        _mm256_storeu_ps(oz + i, _mm256_mul_ps(z, scale));
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+    const __m128 r4 = _mm_set1_ps(radius);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(sx + i);
+        __m128 y = _mm_loadu_ps(sy + i);
+        __m128 z = _mm_loadu_ps(sz + i);
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 scale = _mm_div_ps(r4, len);
+        _mm_storeu_ps(ox + i, _mm_mul_ps(x, scale));
+        _mm_storeu_ps(oy + i, _mm_mul_ps(y, scale));
+        _mm_storeu_ps(oz + i, _mm_mul_ps(z, scale));
+    }
+#endif
+    for (; i < n; ++i) {
+        float scale = radius / sqrtf(sx[i] * sx[i] + sy[i] * sy[i] + sz[i] * sz[i]);
+        ox[i] = sx[i] * scale;
+        oy[i] = sy[i] * scale;
+        oz[i] = sz[i] * scale;
+    }
+}
+
+// builds the edge table of an indexed triangle list. only used for base meshes, so a map is fine.
+inline void subdivisionMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& faces, SubdivisionMesh& mesh) {
+    mesh.x.resize(positions.size());
+    mesh.y.resize(positions.size());
+    mesh.z.resize(positions.size());
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        mesh.x[i] = positions[i].x;
+        mesh.y[i] = positions[i].y;
+        mesh.z[i] = positions[i].z;
+    }
+
+    mesh.faces = faces;
+    mesh.edges.clear();
+    mesh.faceEdges.resize(faces.size());
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> ids;
+    const int sides[3][2] = {{0, 1}, {1, 2}, {0, 2}};
+    for (std::size_t f = 0; f < faces.size(); f += 3) {
+        for (int s = 0; s < 3; ++s) {
+            unsigned int a = faces[f + sides[s][0]];
+            unsigned int b = faces[f + sides[s][1]];
+            std::pair<unsigned int, unsigned int> key(std::min(a, b), std::max(a, b));
+            std::map<std::pair<unsigned int, unsigned int>, unsigned int>::iterator it = ids.find(key);
+            if (it == ids.end()) {
+                it = ids.insert(std::make_pair(key, (unsigned int)(mesh.edges.size() / 2))).first;
+                mesh.edges.push_back(key.first);
+                mesh.edges.push_back(key.second);
+            }
+            mesh.faceEdges[f + s] = it->second;
+        }
+    }
+}
+
+// splits every face into four, projecting the new vertices onto the sphere of the given radius.
+// the vertices of the previous level stay a prefix of the new vertex arrays.
+inline void subdivide(SubdivisionMesh& mesh, float radius) {
+    const std::size_t V = mesh.vertexCount();
+    const std::size_t E = mesh.edgeCount();
+    const std::size_t F = mesh.faceCount();
+
+    mesh.x.resize(V + E);
+    mesh.y.resize(V + E);
+    mesh.z.resize(V + E);
+    std::vector<unsigned int> edges(2 * (2 * E + 3 * F));
+    std::vector<unsigned int> faces(3 * 4 * F);
+    std::vector<unsigned int> faceEdges(3 * 4 * F);
+
+    float* x = &mesh.x[0];
+    float* y = &mesh.y[0];
+    float* z = &mesh.z[0];
+    const unsigned int* parentEdges = &mesh.edges[0];
+    const unsigned int* parentFaces = &mesh.faces[0];
+    const unsigned int* parentFaceEdges = &mesh.faceEdges[0];
+    unsigned int* childEdges = &edges[0];
+    unsigned int* childFaces = &faces[0];
+    unsigned int* childFaceEdges = &faceEdges[0];
+
+    // 1. one midpoint per edge, and each edge splits into 2e = (a, m) and 2e + 1 = (m, b)
+    parallelFor(E, 4096, [=](std::size_t begin, std::size_t end) {
+        const std::size_t BATCH = 64;
+        float sx[BATCH], sy[BATCH], sz[BATCH];
+        for (std::size_t e0 = begin; e0 < end; e0 += BATCH) {
+            std::size_t n = std::min(BATCH, end - e0);
+            for (std::size_t i = 0; i < n; ++i) {
+                unsigned int a = parentEdges[2 * (e0 + i)];
+                unsigned int b = parentEdges[2 * (e0 + i) + 1];
+                sx[i] = x[a] + x[b];
+                sy[i] = y[a] + y[b];
+                sz[i] = z[a] + z[b];
+
+                unsigned int m = V + e0 + i;
+                childEdges[4 * (e0 + i)] = a;
+                childEdges[4 * (e0 + i) + 1] = m;
+                childEdges[4 * (e0 + i) + 2] = m;
+                childEdges[4 * (e0 + i) + 3] = b;
+            }
+            subdivisionNormalize(sx, sy, sz, x + V + e0, y + V + e0, z + V + e0, n, radius);
+        }
+    });
+
+    // 2. four children per face, plus the three interior edges 2E + 3f + {0, 1, 2}
+    parallelFor(F, 4096, [=](std::size_t begin, std::size_t end) {
+        // the half of parent edge e that touches vertex v
+        auto half = [=](unsigned int e, unsigned int v) -> unsigned int {
+            return parentEdges[2 * e] == v ? 2 * e : 2 * e + 1;
+        };
+        for (std::size_t f = begin; f < end; ++f) {
+            unsigned int v1 = parentFaces[3 * f];
+            unsigned int v2 = parentFaces[3 * f + 1];
+            unsigned int v3 = parentFaces[3 * f + 2];
+            unsigned int e12 = parentFaceEdges[3 * f];
+            unsigned int e23 = parentFaceEdges[3 * f + 1];
+            unsigned int e13 = parentFaceEdges[3 * f + 2];
+            unsigned int new1 = V + e12;
+            unsigned int new2 = V + e23;
+            unsigned int new3 = V + e13;
+
+            unsigned int i0 = 2 * E + 3 * f;  // new1 -> new3
+            unsigned int i1 = i0 + 1;         // new1 -> new2
+            unsigned int i2 = i0 + 2;         // new2 -> new3
+
+            const unsigned int children[] = {
+                v1, new1, new3,
+                new1, v2, new2,
+                new1, new2, new3,
+                new3, new2, v3};
+            const unsigned int sides[] = {
+                half(e12, v1), i0, half(e13, v1),
+                half(e12, v2), half(e23, v2), i1,
+                i1, i2, i0,
+                i2, half(e23, v3), half(e13, v3)};
+            std::copy(children, children + 12, childFaces + 12 * f);
+            std::copy(sides, sides + 12, childFaceEdges + 12 * f);
+
+            unsigned int interior[] = {new1, new3, new1, new2, new2, new3};
+            std::copy(interior, interior + 6, childEdges + 2 * i0);
+        }
+    });
+
+    mesh.edges.swap(edges);
+    mesh.faces.swap(faces);
+    mesh.faceEdges.swap(faceEdges);
+}
+
+// copies the structure-of-arrays positions into an interleaved vertex buffer
+inline void subdivisionPositions(const SubdivisionMesh& mesh, std::vector<glm::vec3>& positions) {
+    positions.resize(mesh.vertexCount());
+    glm::vec3* out = positions.empty() ? 0 : &positions[0];
+    const float* x = &mesh.x[0];
+    const float* y = &mesh.y[0];
+    const float* z = &mesh.z[0];
+    parallelFor(positions.size(), 65536, [=](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            out[i] = glm::vec3(x[i], y[i], z[i]);
+    });
+}
+
+#endif
@@ -0,0 +1,224 @@
+#include <GLFW/glfw3.h>
+#include <glad/glad.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/texture_manager.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow* window);
+void scatterRocks(unsigned int count, std::vector<glm::mat4>& transforms, std::vector<glm::vec4>& tints);
+
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+Camera camera(glm::vec3(0.0f, 10.0f, 185.0f));
+
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// the ring around the planet: rocks lie within RING_WIDTH of a circle of RING_RADIUS
+const unsigned int ROCK_COUNT = 100000;
+const float RING_RADIUS = 150.0f;
+const float RING_WIDTH = 25.0f;
+
+// one glDrawElementsInstanced per mesh of the rock, or one glDrawElements per rock to compare against
+bool instancedRocks = true;
+
+// frame time averaged over this many seconds before the window title is updated
+const float FRAME_TIME_INTERVAL = 0.5f;
+
+int main() {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Asteroids", NULL, NULL);
+    if (window == NULL) {
+        std::cerr << "Can not create glfw window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    // the frame time is the point of this demo, so it is not capped by the display
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cerr << "Can not initilize opengl" << std::endl;
+        return -1;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    camera.MovementSpeed = 20.0f;
+
+    // both paths come from one source, the instanced one specialized by SHADER_INSTANCED
+    ShaderVariants rockShaders("rock.vs", "rock.fs");
+    Shader& rockShader = rockShaders.get(0);
+    Shader& instancedShader = rockShaders.get(SHADER_INSTANCED);
+
+    std::unique_ptr<Model> planet(new Model(FileSystem::getPath("resources/objects/planet/planet.obj")));
+    std::unique_ptr<Model> rock(new Model(FileSystem::getPath("resources/objects/rock/rock.obj")));
+
+    std::vector<glm::mat4> rockTransforms;
+    std::vector<glm::vec4> rockTints;
+    scatterRocks(ROCK_COUNT, rockTransforms, rockTints);
+    rock->setInstances(rockTransforms, rockTints);
+    std::cout << rock->instanceCount() << " rocks, " << rock->meshes.size() << " mesh(es) each" << std::endl;
+
+    const glm::vec3 lightDirection = glm::normalize(glm::vec3(-1.0f, -0.3f, -0.5f));
+    float frameTimeStart = glfwGetTime();
+    unsigned int framesCounted = 0;
+    bool countedInstanced = instancedRocks;
+
+    while (!glfwWindowShouldClose(window)) {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        processInput(window);
+        TextureManager::get().uploadReady();
+
+        // a switch starts a new average, so each readout belongs to one path
+        if (countedInstanced != instancedRocks) {
+            countedInstanced = instancedRocks;
+            frameTimeStart = currentFrame;
+            framesCounted = 0;
+        }
+        framesCounted++;
+        if (currentFrame - frameTimeStart >= FRAME_TIME_INTERVAL) {
+            float milliseconds = (currentFrame - frameTimeStart) * 1000.0f / framesCounted;
+            char title[128];
+            std::snprintf(title, sizeof(title), "Asteroids - %u rocks, %s - %.2f ms (%.0f fps)", ROCK_COUNT,
+                          instancedRocks ? "instanced" : "one draw per rock", milliseconds, 1000.0f / milliseconds);
+            glfwSetWindowTitle(window, title);
+            frameTimeStart = currentFrame;
+            framesCounted = 0;
+        }
+
+        glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+
+        rockShader.use();
+        rockShader.setMat4("view", view);
+        rockShader.setMat4("projection", projection);
+        rockShader.setVec3("lightDirection", lightDirection);
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+        rockShader.setMat4("model", model);
+        rockShader.setVec4("tint", glm::vec4(1.0f));
+        planet->Draw(rockShader);
+
+        if (instancedRocks) {
+            instancedShader.use();
+            instancedShader.setMat4("view", view);
+            instancedShader.setMat4("projection", projection);
+            instancedShader.setVec3("lightDirection", lightDirection);
+            rock->DrawInstanced(instancedShader);
+        } else {
+            for (unsigned int i = 0; i < rockTransforms.size(); ++i) {
+                rockShader.setMat4("model", rockTransforms[i]);
+                rockShader.setVec4("tint", rockTints[i]);
+                rock->Draw(rockShader);
+            }
+        }
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    rock.reset();
+    planet.reset();
+
+    glfwTerminate();
+    return 0;
+}
+
+// a flat ring of rocks around the planet, each with a random offset, size, turn and shade
+void scatterRocks(unsigned int count, std::vector<glm::mat4>& transforms, std::vector<glm::vec4>& tints) {
+    std::srand(glfwGetTime() * 1000.0);
+    transforms.resize(count);
+    tints.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        float angle = (float)i / (float)count * 360.0f;
+        float x = std::sin(glm::radians(angle)) * RING_RADIUS + ((std::rand() % 1000) / 1000.0f * 2.0f - 1.0f) * RING_WIDTH;
+        float y = ((std::rand() % 1000) / 1000.0f * 2.0f - 1.0f) * RING_WIDTH * 0.4f;
+        float z = std::cos(glm::radians(angle)) * RING_RADIUS + ((std::rand() % 1000) / 1000.0f * 2.0f - 1.0f) * RING_WIDTH;
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+        float scale = (std::rand() % 20) / 100.0f + 0.05f;
+        model = glm::scale(model, glm::vec3(scale));
+        float rotation = (float)(std::rand() % 360);
+        model = glm::rotate(model, glm::radians(rotation), glm::vec3(0.4f, 0.6f, 0.8f));
+        transforms[i] = model;
+
+        // grey to brown
+        float shade = 0.6f + (std::rand() % 40) / 100.0f;
+        float warmth = (std::rand() % 100) / 100.0f;
+        tints[i] = glm::vec4(shade, shade * (1.0f - 0.15f * warmth), shade * (1.0f - 0.3f * warmth), 1.0f);
+    }
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+}
+
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    camera.ProcessMouseScroll(yoffset);
+}
+
+void processInput(GLFWwindow* window) {
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+        camera.ProcessKeyboard(UP, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+        camera.ProcessKeyboard(DOWN, deltaTime);
+
+    float xoffset = 0.0f, yoffset = 0.0f;
+    const float cameraDirectionSpeed = 210.0f;
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        yoffset += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        yoffset -= 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+        xoffset += 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+        xoffset -= 1.0f;
+    camera.ProcessMouseMovement(xoffset * cameraDirectionSpeed * deltaTime, yoffset * cameraDirectionSpeed * deltaTime);
+
+    // toggle on release so holding the key does not flicker between the two paths
+    static bool instancedKey = false;
+    bool instancedKeyDown = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    if (instancedKey && !instancedKeyDown)
+        instancedRocks = !instancedRocks;
+    instancedKey = instancedKeyDown;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec4 Tint;
+
+// rock.mtl only has a bump map, so the model gives the rock a white texture_diffuse1 and its tint alone colors it
+uniform sampler2D texture_diffuse1;
+uniform vec3 lightDirection;
+
+void main() {
+    float diffuse = max(dot(normalize(Normal), -lightDirection), 0.0);
+    vec4 color = texture(texture_diffuse1, TexCoords) * Tint;
+    FragColor = vec4(color.rgb * (0.2 + 0.8 * diffuse), color.a);
+}
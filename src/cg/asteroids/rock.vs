@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+#ifdef INSTANCED
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in vec4 aInstanceTint;
+#endif
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec4 Tint;
+
+uniform mat4 projection;
+uniform mat4 view;
+#ifndef INSTANCED
+// one object per draw call, the path the instanced one is compared against
+uniform mat4 model;
+uniform vec4 tint;
+#endif
+
+void main() {
+#ifdef INSTANCED
+    // model matrix and tint advance once per instance, see Mesh::setInstanceBuffers
+    mat4 model = aInstanceModel;
+    vec4 tint = aInstanceTint;
+#endif
+    TexCoords = aTexCoords;
+    Normal = mat3(model) * aNormal;
+    Tint = tint;
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}